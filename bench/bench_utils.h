@@ -0,0 +1,160 @@
+#pragma once
+
+#include <media-io/video-scaler.h>
+#include <util/platform.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Helpers shared by the transcoder benchmarks. They only use the libobs media-io
+// scaler, so no obs_startup is needed.
+
+struct BenchFrame {
+    enum video_format format;
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint8_t> planes[MAX_AV_PLANES];
+    uint8_t *data[MAX_AV_PLANES];
+    uint32_t linesize[MAX_AV_PLANES];
+    uint32_t plane_heights[MAX_AV_PLANES];
+
+    BenchFrame(enum video_format format, uint32_t width, uint32_t height) :
+            format(format),
+            width(width),
+            height(height),
+            data(),
+            linesize(),
+            plane_heights() {
+        switch (format) {
+            case VIDEO_FORMAT_I420:
+                addPlane(0, width, height);
+                addPlane(1, (width + 1) / 2, (height + 1) / 2);
+                addPlane(2, (width + 1) / 2, (height + 1) / 2);
+                break;
+            case VIDEO_FORMAT_NV12:
+                addPlane(0, width, height);
+                addPlane(1, (width + 1) / 2 * 2, (height + 1) / 2);
+                break;
+            case VIDEO_FORMAT_BGRA:
+                addPlane(0, width * 4, height);
+                break;
+            default:
+                throw std::invalid_argument("Unsupported bench format");
+        }
+    }
+
+    size_t bytes() const {
+        size_t total = 0;
+        for (auto &plane : planes) {
+            total += plane.size();
+        }
+        return total;
+    }
+
+private:
+    void addPlane(int plane, uint32_t widthBytes, uint32_t rows) {
+        // 32 byte aligned rows, as libobs allocates them
+        linesize[plane] = (widthBytes + 31) & ~31u;
+        plane_heights[plane] = rows;
+        planes[plane].assign((size_t) linesize[plane] * rows, 0);
+        data[plane] = planes[plane].data();
+    }
+};
+
+// Band limited test pattern sampled at pixel centres, u and v are in [0, 1). All frequencies
+// stay below the Nyquist limit of a 480 line image, so sampling the pattern at the output
+// size gives the ideal downscale to compare the scalers against.
+inline double bench_pattern(double u, double v, int component) {
+    double phase = component * 0.7;
+    return 128.0
+           + 40.0 * std::cos(2.0 * M_PI * (31.0 * u + 17.0 * v) + phase)
+           + 30.0 * std::cos(2.0 * M_PI * (97.0 * u - 53.0 * v) + phase)
+           + 20.0 * std::cos(2.0 * M_PI * (149.0 * u + 131.0 * v) + phase);
+}
+
+inline uint8_t bench_clamp(double value) {
+    return (uint8_t) std::lround(std::min(235.0, std::max(16.0, value)));
+}
+
+// Fills a planar or semi-planar yuv 4:2:0 frame with the pattern.
+inline void bench_fill_pattern(BenchFrame &frame) {
+    for (uint32_t y = 0; y < frame.height; y++) {
+        for (uint32_t x = 0; x < frame.width; x++) {
+            double u = (x + 0.5) / frame.width;
+            double v = (y + 0.5) / frame.height;
+            frame.data[0][y * frame.linesize[0] + x] = bench_clamp(bench_pattern(u, v, 0));
+        }
+    }
+    uint32_t cw = (frame.width + 1) / 2;
+    uint32_t ch = (frame.height + 1) / 2;
+    for (uint32_t y = 0; y < ch; y++) {
+        for (uint32_t x = 0; x < cw; x++) {
+            double u = (x + 0.5) / cw;
+            double v = (y + 0.5) / ch;
+            uint8_t cb = bench_clamp(bench_pattern(u, v, 1));
+            uint8_t cr = bench_clamp(bench_pattern(u, v, 2));
+            if (frame.format == VIDEO_FORMAT_NV12) {
+                frame.data[1][y * frame.linesize[1] + x * 2] = cb;
+                frame.data[1][y * frame.linesize[1] + x * 2 + 1] = cr;
+            } else {
+                frame.data[1][y * frame.linesize[1] + x] = cb;
+                frame.data[2][y * frame.linesize[2] + x] = cr;
+            }
+        }
+    }
+}
+
+// PSNR of the luma plane against the pattern sampled at the frame size.
+inline double bench_luma_psnr(const BenchFrame &frame) {
+    double error = 0.0;
+    for (uint32_t y = 0; y < frame.height; y++) {
+        for (uint32_t x = 0; x < frame.width; x++) {
+            double u = (x + 0.5) / frame.width;
+            double v = (y + 0.5) / frame.height;
+            double diff = (double) frame.data[0][y * frame.linesize[0] + x] - bench_clamp(bench_pattern(u, v, 0));
+            error += diff * diff;
+        }
+    }
+    double mse = error / ((double) frame.width * frame.height);
+    return mse == 0.0 ? INFINITY : 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+inline video_scaler_t *bench_create_scaler(const BenchFrame &in, const BenchFrame &out, enum video_scale_type type) {
+    video_scale_info src = {};
+    src.format = in.format;
+    src.width = in.width;
+    src.height = in.height;
+    src.range = VIDEO_RANGE_PARTIAL;
+    src.colorspace = VIDEO_CS_709;
+    video_scale_info dst = src;
+    dst.format = out.format;
+    dst.width = out.width;
+    dst.height = out.height;
+    video_scaler_t *scaler = nullptr;
+    if (video_scaler_create(&scaler, &dst, &src, type) != VIDEO_SCALER_SUCCESS) {
+        throw std::runtime_error("Failed to create video scaler");
+    }
+    return scaler;
+}
+
+inline void bench_scale(video_scaler_t *scaler, const BenchFrame &in, BenchFrame &out) {
+    if (!video_scaler_scale(scaler, out.data, out.linesize, in.data, in.linesize)) {
+        throw std::runtime_error("Failed to scale frame");
+    }
+}
+
+// Average wall time of one call in ns, after a few warm up calls.
+inline uint64_t bench_time_ns(int iterations, const std::function<void()> &fn) {
+    for (int i = 0; i < 5; i++) {
+        fn();
+    }
+    uint64_t start = os_gettime_ns();
+    for (int i = 0; i < iterations; i++) {
+        fn();
+    }
+    return (os_gettime_ns() - start) / iterations;
+}
@@ -92,7 +92,8 @@ if "%BUILD_OBS_NODE%" == "true" (
   if "%RELEASE_TYPE%" == "Debug" set DEBUG_TAG=-D
   node_modules\.bin\cmake-js.cmd configure ^
     %DEBUG_TAG% ^
-    --CDOBS_STUDIO_DIR="%OBS_INSTALL_PREFIX%"
+    --CDOBS_STUDIO_DIR="%OBS_INSTALL_PREFIX%" ^
+    --CDFFMPEG_DIR="%WINDOWS_DEPS_DIR%\win64"
   cmake --build build --config %RELEASE_TYPE%
 
   :: Copy obs-node to prebuild
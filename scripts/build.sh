@@ -115,6 +115,10 @@ if [[ $BUILD_TYPE == 'all' || $BUILD_TYPE == 'obs-node' ]]; then
   if [[ ! -d "$BASE_DIR/node_modules/" ]]; then
     npm ci
   fi
+  # ffmpeg comes from the obs deps on macos, from the system on linux
+  if [[ "$OSTYPE" == "darwin"* ]]; then
+    export PKG_CONFIG_PATH="${MACOS_DEPS_DIR}/lib/pkgconfig:${PKG_CONFIG_PATH}"
+  fi
   node node_modules/.bin/cmake-js configure \
     "$([[ $RELEASE_TYPE == 'Debug' ]] && echo '-D')" \
     --CDOBS_STUDIO_DIR="${OBS_INSTALL_PREFIX}"
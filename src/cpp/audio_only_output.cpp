@@ -0,0 +1,272 @@
+#include "audio_only_output.h"
+#include <util/platform.h>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+
+#define AUDIO_OUTPUT_MAX_PACKETS 500
+
+void AudioOnlyOutput::registerOutput() {
+    obs_output_info info = {};
+    info.id = id;
+    info.flags = OBS_OUTPUT_AUDIO | OBS_OUTPUT_ENCODED | OBS_OUTPUT_SERVICE;
+    info.encoded_audio_codecs = "aac";
+    info.get_name = get_name;
+    info.create = create;
+    info.destroy = destroy;
+    info.start = start;
+    info.stop = stop;
+    info.encoded_packet = encoded_packet;
+    info.get_total_bytes = get_total_bytes;
+    info.get_dropped_frames = get_dropped_frames;
+    info.get_congestion = get_congestion;
+    obs_register_output(&info);
+}
+
+AudioOnlyOutput::AudioOnlyOutput(obs_output_t *output) :
+        output(output),
+        context(nullptr),
+        thread(),
+        mutex(),
+        cv(),
+        packets(),
+        stopping(false),
+        start_dts(0),
+        has_start_dts(false),
+        total_bytes(0),
+        dropped_packets(0) {
+}
+
+AudioOnlyOutput::~AudioOnlyOutput() {
+    stopping = true;
+    cv.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+    clearPackets();
+}
+
+const char *AudioOnlyOutput::get_name(void *) {
+    return "Audio Only Output";
+}
+
+void *AudioOnlyOutput::create(obs_data_t *, obs_output_t *output) {
+    return new AudioOnlyOutput(output);
+}
+
+void AudioOnlyOutput::destroy(void *data) {
+    delete (AudioOnlyOutput *) data;
+}
+
+bool AudioOnlyOutput::start(void *data) {
+    auto self = (AudioOnlyOutput *) data;
+    if (!obs_output_can_begin_data_capture(self->output, 0)) {
+        return false;
+    }
+    if (!obs_output_initialize_encoders(self->output, 0)) {
+        return false;
+    }
+
+    // a reconnect starts again once the previous connection gave up
+    if (self->thread.joinable()) {
+        self->thread.join();
+    }
+    self->clearPackets();
+    self->stopping = false;
+    self->has_start_dts = false;
+    self->total_bytes = 0;
+    self->thread = std::thread(&AudioOnlyOutput::run, self);
+    return true;
+}
+
+void AudioOnlyOutput::stop(void *data, uint64_t) {
+    auto self = (AudioOnlyOutput *) data;
+    self->stopping = true;
+    self->cv.notify_all();
+}
+
+void AudioOnlyOutput::encoded_packet(void *data, encoder_packet *packet) {
+    auto self = (AudioOnlyOutput *) data;
+    if (!packet) {
+        obs_output_signal_stop(self->output, OBS_OUTPUT_ENCODE_ERROR);
+        return;
+    }
+
+    encoder_packet copy = {};
+    obs_encoder_packet_ref(&copy, packet);
+    {
+        std::unique_lock<std::mutex> lock(self->mutex);
+        // never block the encoder thread on a stalled connection, drop the oldest audio instead
+        if (self->packets.size() >= AUDIO_OUTPUT_MAX_PACKETS) {
+            obs_encoder_packet_release(&self->packets.front());
+            self->packets.pop_front();
+            self->dropped_packets++;
+        }
+        self->packets.push_back(copy);
+    }
+    self->cv.notify_all();
+}
+
+uint64_t AudioOnlyOutput::get_total_bytes(void *data) {
+    return ((AudioOnlyOutput *) data)->total_bytes;
+}
+
+int AudioOnlyOutput::get_dropped_frames(void *data) {
+    return ((AudioOnlyOutput *) data)->dropped_packets;
+}
+
+float AudioOnlyOutput::get_congestion(void *data) {
+    auto self = (AudioOnlyOutput *) data;
+    std::unique_lock<std::mutex> lock(self->mutex);
+    return (float) self->packets.size() / AUDIO_OUTPUT_MAX_PACKETS;
+}
+
+int AudioOnlyOutput::interrupt_callback(void *param) {
+    return ((AudioOnlyOutput *) param)->stopping;
+}
+
+bool AudioOnlyOutput::open() {
+    obs_service_t *service = obs_output_get_service(output);
+    obs_encoder_t *encoder = obs_output_get_audio_encoder(output, 0);
+    if (!service || !encoder) {
+        return false;
+    }
+
+    std::string url = obs_service_get_url(service) ? obs_service_get_url(service) : "";
+    std::string key = obs_service_get_key(service) ? obs_service_get_key(service) : "";
+    bool is_rtmp = url.rfind("rtmp", 0) == 0;
+    if (is_rtmp && !key.empty()) {
+        if (url.back() == '/') {
+            url.pop_back();
+        }
+        url += "/" + key;
+    }
+
+    if (avformat_alloc_output_context2(&context, nullptr, is_rtmp ? "flv" : "mpegts", url.c_str()) < 0) {
+        blog(LOG_ERROR, "audio output: failed to create output context");
+        return false;
+    }
+
+    AVStream *stream = avformat_new_stream(context, nullptr);
+    AVCodecParameters *par = stream->codecpar;
+    par->codec_type = AVMEDIA_TYPE_AUDIO;
+    par->codec_id = AV_CODEC_ID_AAC;
+    par->sample_rate = (int) obs_encoder_get_sample_rate(encoder);
+    int channels = (int) audio_output_get_channels(obs_encoder_audio(encoder));
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 28, 100)
+    av_channel_layout_default(&par->ch_layout, channels);
+#else
+    par->channels = channels;
+    par->channel_layout = av_get_default_channel_layout(channels);
+#endif
+    obs_data_t *encoder_settings = obs_encoder_get_settings(encoder);
+    par->bit_rate = obs_data_get_int(encoder_settings, "bitrate") * 1000;
+    obs_data_release(encoder_settings);
+
+    uint8_t *extra_data = nullptr;
+    size_t extra_size = 0;
+    if (obs_encoder_get_extra_data(encoder, &extra_data, &extra_size) && extra_size) {
+        par->extradata = (uint8_t *) av_mallocz(extra_size + AV_INPUT_BUFFER_PADDING_SIZE);
+        memcpy(par->extradata, extra_data, extra_size);
+        par->extradata_size = (int) extra_size;
+    }
+    stream->time_base = {1, par->sample_rate};
+
+    context->interrupt_callback.callback = interrupt_callback;
+    context->interrupt_callback.opaque = this;
+    int ret = avio_open2(&context->pb, url.c_str(), AVIO_FLAG_WRITE, &context->interrupt_callback, nullptr);
+    if (ret >= 0) {
+        ret = avformat_write_header(context, nullptr);
+    }
+    if (ret < 0) {
+        blog(LOG_ERROR, "audio output: failed to open %s: %d", obs_service_get_url(service), ret);
+        close();
+        return false;
+    }
+    return true;
+}
+
+void AudioOnlyOutput::close() {
+    if (context) {
+        if (context->pb) {
+            avio_closep(&context->pb);
+        }
+        avformat_free_context(context);
+        context = nullptr;
+    }
+}
+
+void AudioOnlyOutput::run() {
+    if (!open()) {
+        if (!stopping) {
+            obs_output_signal_stop(output, OBS_OUTPUT_CONNECT_FAILED);
+        }
+        return;
+    }
+    if (!obs_output_begin_data_capture(output, 0)) {
+        close();
+        return;
+    }
+
+    AVPacket *av_packet = av_packet_alloc();
+    bool failed = false;
+    while (true) {
+        encoder_packet packet = {};
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this] { return stopping || !packets.empty(); });
+            if (stopping) {
+                break;
+            }
+            packet = packets.front();
+            packets.pop_front();
+        }
+
+        if (!has_start_dts) {
+            start_dts = packet.dts;
+            has_start_dts = true;
+        }
+        AVRational time_base = {(int) packet.timebase_num, (int) packet.timebase_den};
+        AVStream *stream = context->streams[0];
+        av_packet->data = packet.data;
+        av_packet->size = (int) packet.size;
+        av_packet->stream_index = 0;
+        av_packet->pts = av_rescale_q(packet.pts - start_dts, time_base, stream->time_base);
+        av_packet->dts = av_rescale_q(packet.dts - start_dts, time_base, stream->time_base);
+        av_packet->flags = AV_PKT_FLAG_KEY;
+
+        size_t size = packet.size;
+        int ret = av_write_frame(context, av_packet);
+        obs_encoder_packet_release(&packet);
+        if (ret < 0) {
+            blog(LOG_ERROR, "audio output: failed to write packet: %d", ret);
+            failed = true;
+            break;
+        }
+        total_bytes += size;
+    }
+    av_packet_free(&av_packet);
+
+    if (!failed) {
+        av_write_trailer(context);
+    }
+    close();
+    clearPackets();
+
+    // libobs ends the data capture and reconnects if it's enabled
+    if (failed) {
+        obs_output_signal_stop(output, OBS_OUTPUT_DISCONNECTED);
+    } else {
+        obs_output_end_data_capture(output);
+    }
+}
+
+void AudioOnlyOutput::clearPackets() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (auto &packet : packets) {
+        obs_encoder_packet_release(&packet);
+    }
+    packets.clear();
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <obs.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct AVFormatContext;
+
+// The rtmp and mpegts outputs of obs-outputs/obs-ffmpeg are audio+video outputs and refuse to
+// start without a video encoder, audio only outputs mux the encoded AAC packets with libavformat.
+class AudioOnlyOutput {
+
+public:
+    static constexpr const char *id = "obs_node_audio_output";
+
+    // Registers the output type with libobs, called once after obs_startup.
+    static void registerOutput();
+
+private:
+    explicit AudioOnlyOutput(obs_output_t *output);
+
+    ~AudioOnlyOutput();
+
+    static const char *get_name(void *type_data);
+    static void *create(obs_data_t *settings, obs_output_t *output);
+    static void destroy(void *data);
+    static bool start(void *data);
+    static void stop(void *data, uint64_t ts);
+    static void encoded_packet(void *data, encoder_packet *packet);
+    static uint64_t get_total_bytes(void *data);
+    static int get_dropped_frames(void *data);
+    static float get_congestion(void *data);
+    static int interrupt_callback(void *param);
+
+    bool open();
+
+    void close();
+
+    void run();
+
+    void clearPackets();
+
+    obs_output_t *output;
+    AVFormatContext *context;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<encoder_packet> packets;
+    std::atomic<bool> stopping;
+    int64_t start_dts;
+    bool has_start_dts;
+    std::atomic<uint64_t> total_bytes;
+    std::atomic<int> dropped_packets;
+};
@@ -0,0 +1,85 @@
+#include "audio_ring.h"
+#include <algorithm>
+#include <cstring>
+#include <media-io/audio-io.h>
+
+#define AUDIO_RING_SLOTS 64
+#define AUDIO_RING_SLOT_FRAMES AUDIO_OUTPUT_FRAMES
+
+AudioRing::AudioRing() :
+        read(0),
+        write(0),
+        slots(),
+        storage(),
+        channels(0),
+        sample_rate(0) {
+}
+
+AudioRing::~AudioRing() {
+    close();
+}
+
+void AudioRing::open(size_t c, size_t rate) {
+    channels = c;
+    sample_rate = rate;
+    read = 0;
+    write = 0;
+    storage.assign(AUDIO_RING_SLOTS * channels * AUDIO_RING_SLOT_FRAMES, 0.0f);
+    slots.assign(AUDIO_RING_SLOTS, AudioRingPacket());
+    for (size_t i = 0; i < AUDIO_RING_SLOTS; i++) {
+        for (size_t ch = 0; ch < channels; ch++) {
+            slots[i].data[ch] = storage.data() + (i * channels + ch) * AUDIO_RING_SLOT_FRAMES;
+        }
+    }
+}
+
+void AudioRing::close() {
+    read = 0;
+    write = 0;
+    slots.clear();
+    storage.clear();
+    channels = 0;
+}
+
+bool AudioRing::push(uint64_t timestamp, uint8_t *const *data, uint32_t frames) {
+    if (slots.empty()) {
+        return false;
+    }
+
+    size_t w = write.load(std::memory_order_relaxed);
+    size_t r = read.load(std::memory_order_acquire);
+    size_t needed = (frames + AUDIO_RING_SLOT_FRAMES - 1) / AUDIO_RING_SLOT_FRAMES;
+    if (AUDIO_RING_SLOTS - (w - r) < needed) {
+        return false;
+    }
+
+    for (uint32_t offset = 0; offset < frames; offset += AUDIO_RING_SLOT_FRAMES) {
+        AudioRingPacket &slot = slots[w % AUDIO_RING_SLOTS];
+        slot.frames = std::min<uint32_t>(frames - offset, AUDIO_RING_SLOT_FRAMES);
+        slot.timestamp = timestamp + audio_frames_to_ns(sample_rate, offset);
+        for (size_t ch = 0; ch < channels; ch++) {
+            memcpy(slot.data[ch], (const float *) data[ch] + offset, slot.frames * sizeof(float));
+        }
+        w++;
+    }
+
+    // publish all slots of the packet at once
+    write.store(w, std::memory_order_release);
+    return true;
+}
+
+AudioRingPacket *AudioRing::front() {
+    size_t r = read.load(std::memory_order_relaxed);
+    if (slots.empty() || r == write.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    return &slots[r % AUDIO_RING_SLOTS];
+}
+
+void AudioRing::pop() {
+    read.store(read.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void AudioRing::clear() {
+    read.store(write.load(std::memory_order_acquire), std::memory_order_release);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <obs.h>
+
+struct AudioRingPacket {
+    uint64_t timestamp;
+    uint32_t frames;
+    float *data[MAX_AUDIO_CHANNELS];
+};
+
+// Wait-free single producer / single consumer ring of planar float audio packets.
+// push() is only called by the source audio thread, front()/pop()/clear() only by
+// the audio output thread. Packets longer than a slot are split over several slots.
+class AudioRing {
+
+public:
+    AudioRing();
+    ~AudioRing();
+
+    void open(size_t channels, size_t sampleRate);
+
+    void close();
+
+    // Returns false if the ring has no room for the whole packet, nothing is queued then.
+    bool push(uint64_t timestamp, uint8_t *const *data, uint32_t frames);
+
+    // Returns the oldest packet or null if the ring is empty.
+    AudioRingPacket *front();
+
+    void pop();
+
+    void clear();
+
+private:
+    alignas(64) std::atomic<size_t> read;
+    alignas(64) std::atomic<size_t> write;
+    std::vector<AudioRingPacket> slots;
+    std::vector<float> storage;
+    size_t channels;
+    size_t sample_rate;
+};
@@ -1,6 +1,7 @@
 #include "callback.h"
 
 VolmeterCallback Callback::volmeterCallback;
+OutputEventCallback Callback::outputEventCallback;
 
 void Callback::setVolmeterCallback(VolmeterCallback &callback) {
     volmeterCallback = callback;
@@ -8,4 +9,12 @@ void Callback::setVolmeterCallback(VolmeterCallback &callback) {
 
 VolmeterCallback Callback::getVolmeterCallback() {
     return volmeterCallback;
-}
\ No newline at end of file
+}
+
+void Callback::setOutputEventCallback(OutputEventCallback &callback) {
+    outputEventCallback = callback;
+}
+
+OutputEventCallback Callback::getOutputEventCallback() {
+    return outputEventCallback;
+}
@@ -1,5 +1,7 @@
 #pragma once
 #include <functional>
+#include <string>
+#include <vector>
 
 typedef std::function<void(
         std::string &sourceId,
@@ -9,11 +11,20 @@ typedef std::function<void(
         std::vector<float> &peak,
         std::vector<float> &input_peak)> VolmeterCallback;
 
+typedef std::function<void(
+        const std::string &outputId,
+        const std::string &event,
+        int code,
+        int attempt)> OutputEventCallback;
+
 class Callback {
 public:
     static void setVolmeterCallback(VolmeterCallback &callback);
     static VolmeterCallback getVolmeterCallback();
+    static void setOutputEventCallback(OutputEventCallback &callback);
+    static OutputEventCallback getOutputEventCallback();
 
 private:
     static VolmeterCallback volmeterCallback;
+    static OutputEventCallback outputEventCallback;
 };
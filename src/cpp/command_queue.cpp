@@ -0,0 +1,108 @@
+#include "command_queue.h"
+#include <algorithm>
+#include <obs.h>
+#include <util/platform.h>
+
+CommandQueue &CommandQueue::getInstance() {
+    static CommandQueue queue;
+    return queue;
+}
+
+CommandQueue::CommandQueue() :
+        mutex(),
+        cv(),
+        idle_cv(),
+        commands(),
+        stopping(false),
+        running(false),
+        runCount(0),
+        lastRunNs(0),
+        totalRunNs(0),
+        maxRunNs(0),
+        totalWaitNs(0),
+        syncCalls(0),
+        totalSyncBlockedNs(0),
+        maxSyncBlockedNs(0) {
+}
+
+CommandQueue::~CommandQueue() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void CommandQueue::post(std::function<void()> command) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!thread.joinable()) {
+            thread = std::thread(&CommandQueue::run, this);
+            blog(LOG_INFO, "Control thread started");
+        }
+        commands.push_back({std::move(command), os_gettime_ns()});
+    }
+    cv.notify_one();
+}
+
+void CommandQueue::drain() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle_cv.wait(lock, [this] { return commands.empty() && !running; });
+}
+
+void CommandQueue::recordSync(uint64_t blockedNs) {
+    std::unique_lock<std::mutex> lock(mutex);
+    syncCalls++;
+    totalSyncBlockedNs += blockedNs;
+    maxSyncBlockedNs = std::max(maxSyncBlockedNs, blockedNs);
+}
+
+CommandStats CommandQueue::getStats() {
+    std::unique_lock<std::mutex> lock(mutex);
+    CommandStats stats = {};
+    stats.commands = runCount;
+    stats.pending = commands.size();
+    stats.lastRunNs = lastRunNs;
+    stats.avgRunNs = runCount ? totalRunNs / runCount : 0;
+    stats.maxRunNs = maxRunNs;
+    stats.avgWaitNs = runCount ? totalWaitNs / runCount : 0;
+    stats.syncCalls = syncCalls;
+    stats.avgSyncBlockedNs = syncCalls ? totalSyncBlockedNs / syncCalls : 0;
+    stats.maxSyncBlockedNs = maxSyncBlockedNs;
+    return stats;
+}
+
+void CommandQueue::run() {
+    while (true) {
+        Command command;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this] { return stopping || !commands.empty(); });
+            if (stopping) {
+                return;
+            }
+            command = std::move(commands.front());
+            commands.pop_front();
+            running = true;
+        }
+
+        uint64_t start = os_gettime_ns();
+        // commands report their own errors, see queueCommand in main.cpp
+        command.fn();
+        uint64_t end = os_gettime_ns();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        runCount++;
+        lastRunNs = end - start;
+        totalRunNs += lastRunNs;
+        maxRunNs = std::max(maxRunNs, lastRunNs);
+        totalWaitNs += start - command.postedAt;
+        running = false;
+        if (commands.empty()) {
+            idle_cv.notify_all();
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+struct CommandStats {
+    uint64_t commands;
+    uint64_t pending;
+    uint64_t lastRunNs;
+    uint64_t avgRunNs;
+    uint64_t maxRunNs;
+    uint64_t avgWaitNs;
+    // time the node main thread spent in the synchronous variants
+    uint64_t syncCalls;
+    uint64_t avgSyncBlockedNs;
+    uint64_t maxSyncBlockedNs;
+};
+
+// Runs the slow libobs commands (startup, opening sources) one at a time on a
+// control thread, in the order they were posted, off the node main thread.
+class CommandQueue {
+
+public:
+    static CommandQueue &getInstance();
+
+    void post(std::function<void()> command);
+
+    // Blocks until every posted command has run, shutdown can't pull the studio from under them.
+    void drain();
+
+    // Records a synchronous call that blocked the main thread, to compare with the queued variants.
+    void recordSync(uint64_t blockedNs);
+
+    CommandStats getStats();
+
+private:
+    struct Command {
+        std::function<void()> fn;
+        uint64_t postedAt;
+    };
+
+    CommandQueue();
+    ~CommandQueue();
+
+    void run();
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::condition_variable idle_cv;
+    std::deque<Command> commands;
+    std::thread thread;
+    bool stopping;
+    bool running;
+
+    uint64_t runCount;
+    uint64_t lastRunNs;
+    uint64_t totalRunNs;
+    uint64_t maxRunNs;
+    uint64_t totalWaitNs;
+    uint64_t syncCalls;
+    uint64_t totalSyncBlockedNs;
+    uint64_t maxSyncBlockedNs;
+};
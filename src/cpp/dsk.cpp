@@ -1,6 +1,9 @@
 #include "dsk.h"
+#include <stdexcept>
 
-Dsk::Dsk(std::string &id, std::string &position, std::string &url, int left, int top, int width, int height) :
+Dsk::Dsk(std::string &id, std::string &position, std::string &url, int left, int top, int width, int height,
+         obs_scene_t *dsk_scene) :
+    obs_scene_item(nullptr),
     position(position),
     url(url),
     left(left),
@@ -12,10 +15,79 @@ Dsk::Dsk(std::string &id, std::string &position, std::string &url, int left, int
     obs_data_set_bool(obs_data, "unload", false);
     obs_source = obs_source_create("image_source", id.c_str(), obs_data, nullptr);
     obs_data_release(obs_data);
+    if (!obs_source) {
+        throw std::runtime_error("Failed to create dsk " + id);
+    }
+
+    // Add the source to the dsk scene
+    obs_scene_item = obs_scene_add(dsk_scene, obs_source);
+    if (!obs_scene_item) {
+        obs_source_release(obs_source);
+        throw std::runtime_error("Failed to add scene item.");
+    }
+    applyTransform();
+
+    // set top most
+    obs_sceneitem_set_order(obs_scene_item, OBS_ORDER_MOVE_TOP);
 }
 
 Dsk::~Dsk() {
+    if (obs_scene_item) {
+        obs_sceneitem_remove(obs_scene_item);
+    }
     if (obs_source) {
         obs_source_release(obs_source);
     }
-}
\ No newline at end of file
+}
+
+void Dsk::update(std::string &position, std::string &url, int left, int top, int width, int height) {
+    if (url != this->url) {
+        obs_data_t *obs_data = obs_data_create();
+        obs_data_set_string(obs_data, "file", url.c_str());
+        obs_source_update(obs_source, obs_data);
+        obs_data_release(obs_data);
+        this->url = url;
+    }
+    this->position = position;
+    this->left = left;
+    this->top = top;
+    this->width = width;
+    this->height = height;
+    applyTransform();
+}
+
+void Dsk::applyTransform() {
+    // set position
+    struct vec2 pos = {};
+    pos.x = (float) left;
+    pos.y = (float) top;
+    obs_sceneitem_set_pos(obs_scene_item, &pos);
+
+    // set align
+    uint32_t align = 0;
+    if (position == "top") {
+        align = OBS_ALIGN_TOP;
+    } else if (position == "top-right") {
+        align = OBS_ALIGN_TOP + OBS_ALIGN_RIGHT;
+    } else if (position == "right") {
+        align = OBS_ALIGN_RIGHT;
+    } else if (position == "bottom-right") {
+        align = OBS_ALIGN_BOTTOM + OBS_ALIGN_RIGHT;
+    } else if (position == "bottom") {
+        align = OBS_ALIGN_BOTTOM;
+    } else if (position == "bottom-left") {
+        align = OBS_ALIGN_BOTTOM + OBS_ALIGN_LEFT;
+    } else if (position == "left") {
+        align = OBS_ALIGN_LEFT;
+    } else if (position == "top-left") {
+        align = OBS_ALIGN_TOP + OBS_ALIGN_LEFT;
+    }
+    obs_sceneitem_set_bounds_alignment(obs_scene_item, align);
+
+    // set size
+    struct vec2 bounds = {};
+    bounds.x = (float) width;
+    bounds.y = (float) height;
+    obs_sceneitem_set_bounds_type(obs_scene_item, OBS_BOUNDS_SCALE_INNER);
+    obs_sceneitem_set_bounds(obs_scene_item, &bounds);
+}
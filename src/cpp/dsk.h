@@ -2,14 +2,20 @@
 #include <string>
 #include <obs.h>
 
+// Downstream keyer, an image item of the studio wide dsk scene that is rendered above the transition.
 class Dsk {
 
 public:
-    Dsk(std::string &id, std::string &position, std::string &url, int left, int top, int width, int height);
+    Dsk(std::string &id, std::string &position, std::string &url, int left, int top, int width, int height,
+        obs_scene_t *dsk_scene);
     ~Dsk();
 
+    void update(std::string &position, std::string &url, int left, int top, int width, int height);
+
     std::string &getPosition() { return position; }
 
+    std::string &getUrl() { return url; }
+
     int getLeft() const { return left; }
 
     int getTop() const { return top; }
@@ -21,11 +27,14 @@ public:
     obs_source_t *getObsSource() { return obs_source; }
 
 private:
+    void applyTransform();
+
     obs_source_t *obs_source;
+    obs_sceneitem_t *obs_scene_item;
     std::string position;
     std::string url;
     int left;
     int top;
     int width;
     int height;
-};
\ No newline at end of file
+};
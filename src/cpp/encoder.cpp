@@ -0,0 +1,257 @@
+#include "encoder.h"
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <util/platform.h>
+
+#define LATENCY_PROBE_ID "obs_node_encoder_latency_probe"
+
+std::mutex Encoder::mutex;
+std::map<std::string, std::weak_ptr<Encoder>> Encoder::encoders;
+
+std::shared_ptr<Encoder> Encoder::acquire(OutputSettings *settings, video_t *video, audio_t *audio,
+                                          obs_service_t *service) {
+    std::string key = getKey(settings, video, audio);
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = encoders.find(key);
+    if (it != encoders.end()) {
+        if (auto encoder = it->second.lock()) {
+            blog(LOG_INFO, "Output %s shares encoder %s", settings->server.c_str(), key.c_str());
+            return encoder;
+        }
+    }
+
+    // drop entries whose encoders are gone
+    for (auto e = encoders.begin(); e != encoders.end();) {
+        e = e->second.expired() ? encoders.erase(e) : std::next(e);
+    }
+
+    auto encoder = std::make_shared<Encoder>(settings, video, audio, service);
+    encoder->key = key;
+    encoders[key] = encoder;
+    return encoder;
+}
+
+std::string Encoder::getVideoEncoderId(OutputSettings *settings) {
+    return settings->hardwareEnable ? "ffmpeg_nvenc" : "obs_x264";
+}
+
+std::string Encoder::getKey(OutputSettings *settings, video_t *video, audio_t *audio) {
+    // everything that ends up in the encoded packets, the destination doesn't
+    char pointers[64];
+    snprintf(pointers, sizeof(pointers), "%p/%p", (void *) video, (void *) audio);
+    std::string key = std::string(pointers) + "|aac/" + std::to_string(settings->audioBitrateKbps);
+    if (video && !settings->audioOnly) {
+        key += "|" + getVideoEncoderId(settings) + "/" + std::to_string(settings->width) + "x" +
+               std::to_string(settings->height) + "/" + std::to_string(settings->keyintSec) + "/" +
+               settings->rateControl + "/" + std::to_string(settings->videoBitrateKbps) + "/" + settings->preset +
+               "/" + settings->profile + "/" + settings->tune + "/" + settings->x264opts;
+    }
+    return key;
+}
+
+Encoder::Encoder(OutputSettings *settings, video_t *video, audio_t *audio, obs_service_t *service) :
+        key(),
+        video_encoder(nullptr),
+        audio_encoder(nullptr),
+        latency_probe(nullptr),
+        probe_mutex(),
+        connected_outputs(0),
+        avg_latency_ns(0) {
+    // the destructor doesn't run if this throws, release whatever was created so far
+    obs_data_t *video_encoder_settings = nullptr;
+    try {
+        // video encoder, audio only outputs have no video
+        if (video && !settings->audioOnly) {
+            std::string encoder = getVideoEncoderId(settings);
+            video_encoder = obs_video_encoder_create(encoder.c_str(), "h264 enc", nullptr, nullptr);
+            if (!video_encoder) {
+                throw std::runtime_error("Failed to create video encoder.");
+            }
+
+            video_encoder_settings = obs_encoder_get_settings(video_encoder);
+            if (!video_encoder_settings) {
+                throw std::runtime_error("Failed to get video encoder settings.");
+            }
+
+            obs_data_set_int(video_encoder_settings, "keyint_sec", settings->keyintSec);
+            obs_data_set_string(video_encoder_settings, "rate_control", settings->rateControl.c_str());
+            obs_data_set_int(video_encoder_settings, "width", settings->width);
+            obs_data_set_int(video_encoder_settings, "height", settings->height);
+            obs_data_set_string(video_encoder_settings, "preset", settings->preset.c_str());
+            obs_data_set_string(video_encoder_settings, "profile", settings->profile.c_str());
+            obs_data_set_string(video_encoder_settings, "tune", settings->tune.c_str());
+            obs_data_set_string(video_encoder_settings, "x264opts", settings->x264opts.c_str());
+            obs_data_set_int(video_encoder_settings, "bitrate", settings->videoBitrateKbps);
+
+            obs_encoder_update(video_encoder, video_encoder_settings);
+            obs_encoder_set_scaled_size(video_encoder, settings->width, settings->height);
+            obs_encoder_set_video(video_encoder, video);
+        }
+
+        // audio encoder
+        audio_encoder = obs_audio_encoder_create("ffmpeg_aac", "aac enc", nullptr, 0, nullptr);
+        if (!audio_encoder) {
+            throw std::runtime_error("Failed to create audio encoder.");
+        }
+
+        obs_data_t *audio_encoder_settings = obs_encoder_get_settings(audio_encoder);
+        if (!audio_encoder_settings) {
+            throw std::runtime_error("Failed to get audio encoder settings.");
+        }
+
+        obs_data_set_int(audio_encoder_settings, "bitrate", settings->audioBitrateKbps);
+        obs_encoder_update(audio_encoder, audio_encoder_settings);
+        obs_encoder_set_audio(audio_encoder, audio);
+
+        // service limits are applied once, outputs sharing the encoder get the first service's limits
+        obs_service_apply_encoder_settings(service, video_encoder_settings, audio_encoder_settings);
+        obs_data_release(video_encoder_settings);
+        obs_data_release(audio_encoder_settings);
+    } catch (...) {
+        obs_data_release(video_encoder_settings);
+        obs_encoder_release(video_encoder);
+        obs_encoder_release(audio_encoder);
+        throw;
+    }
+
+    if (video_encoder) {
+        createLatencyProbe();
+    }
+}
+
+Encoder::~Encoder() {
+    // stops the packet callbacks before the encoders go away
+    if (latency_probe) {
+        obs_output_stop(latency_probe);
+        obs_output_release(latency_probe);
+    }
+    obs_encoder_release(video_encoder);
+    obs_encoder_release(audio_encoder);
+}
+
+void Encoder::registerLatencyProbe() {
+    obs_output_info info = {};
+    info.id = LATENCY_PROBE_ID;
+    info.flags = OBS_OUTPUT_VIDEO | OBS_OUTPUT_ENCODED;
+    info.get_name = probe_get_name;
+    info.create = probe_create;
+    info.destroy = probe_destroy;
+    info.start = probe_start;
+    info.stop = probe_stop;
+    info.encoded_packet = probe_encoded_packet;
+    obs_register_output(&info);
+}
+
+void Encoder::createLatencyProbe() {
+    obs_data_t *probe_settings = obs_data_create();
+    obs_data_set_int(probe_settings, "encoder", (long long) (intptr_t) this);
+    latency_probe = obs_output_create(LATENCY_PROBE_ID, "encoder latency probe", probe_settings, nullptr);
+    obs_data_release(probe_settings);
+    if (!latency_probe) {
+        blog(LOG_WARNING, "Failed to create the encoder latency probe");
+        return;
+    }
+    obs_output_set_video_encoder(latency_probe, video_encoder);
+}
+
+void Encoder::addConnectedOutput() {
+    std::unique_lock<std::mutex> lock(probe_mutex);
+    if (connected_outputs++ == 0 && latency_probe) {
+        avg_latency_ns = 0;
+        if (!obs_output_start(latency_probe)) {
+            blog(LOG_WARNING, "Failed to start the encoder latency probe");
+        }
+    }
+}
+
+void Encoder::removeConnectedOutput() {
+    std::unique_lock<std::mutex> lock(probe_mutex);
+    if (connected_outputs > 0 && --connected_outputs == 0 && latency_probe) {
+        obs_output_stop(latency_probe);
+    }
+}
+
+const char *Encoder::probe_get_name(void *) {
+    return "Encoder Latency Probe";
+}
+
+void *Encoder::probe_create(obs_data_t *settings, obs_output_t *) {
+    return (void *) (intptr_t) obs_data_get_int(settings, "encoder");
+}
+
+void Encoder::probe_destroy(void *) {
+}
+
+bool Encoder::probe_start(void *data) {
+    auto encoder = (Encoder *) data;
+    if (!obs_output_can_begin_data_capture(encoder->latency_probe, 0) ||
+        !obs_output_initialize_encoders(encoder->latency_probe, 0)) {
+        return false;
+    }
+    return obs_output_begin_data_capture(encoder->latency_probe, 0);
+}
+
+void Encoder::probe_stop(void *data, uint64_t) {
+    obs_output_end_data_capture(((Encoder *) data)->latency_probe);
+}
+
+void Encoder::probe_encoded_packet(void *data, encoder_packet *packet) {
+    if (!packet) {
+        return;
+    }
+    // dts_usec is the encoder's first frame timestamp plus the packet's dts, shifted by pts - dts it's
+    // the timestamp of the video frame the packet encodes, on the os_gettime_ns clock
+    auto encoder = (Encoder *) data;
+    int64_t frame_ts_us = packet->dts_usec +
+                          (packet->pts - packet->dts) * 1000000 * packet->timebase_num / packet->timebase_den;
+    int64_t latency = (int64_t) os_gettime_ns() - frame_ts_us * 1000;
+    if (latency < 0) {
+        return;
+    }
+    uint64_t avg = encoder->avg_latency_ns;
+    encoder->avg_latency_ns = avg ? (avg * 15 + latency) / 16 : latency;
+}
+
+uint64_t Encoder::getAvgLatencyNs() {
+    return avg_latency_ns;
+}
+
+obs_encoder_t *Encoder::getVideoEncoder() {
+    return video_encoder;
+}
+
+obs_encoder_t *Encoder::getAudioEncoder() {
+    return audio_encoder;
+}
+
+bool Encoder::setVideoBitrate(int bitrateKbps) {
+    // obs_x264 reconfigures bitrate and vbv of a running encoder, other encoders apply it on the next start
+    if (!video_encoder || strcmp(obs_encoder_get_id(video_encoder), "obs_x264") != 0) {
+        return false;
+    }
+
+    obs_data_t *video_encoder_settings = obs_encoder_get_settings(video_encoder);
+    if (!video_encoder_settings) {
+        return false;
+    }
+    if (strcmp(obs_data_get_string(video_encoder_settings, "rate_control"), "CRF") == 0) {
+        obs_data_release(video_encoder_settings);
+        return false;
+    }
+
+    {
+        // the packets don't match the key anymore
+        std::unique_lock<std::mutex> lock(mutex);
+        auto it = encoders.find(key);
+        if (it != encoders.end() && it->second.lock().get() == this) {
+            encoders.erase(it);
+        }
+    }
+
+    obs_data_set_int(video_encoder_settings, "bitrate", bitrateKbps);
+    obs_encoder_update(video_encoder, video_encoder_settings);
+    obs_data_release(video_encoder_settings);
+    blog(LOG_INFO, "Video encoder bitrate changed to %dkbps", bitrateKbps);
+    return true;
+}
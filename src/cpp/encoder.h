@@ -0,0 +1,72 @@
+#pragma once
+
+#include "settings.h"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <obs.h>
+
+// Video/audio encoder pair, shared by every output whose encoder settings and
+// video/audio sources are the same. libobs fans the packets out to all outputs
+// using the encoders, each output still starts and stops on its own.
+class Encoder {
+
+public:
+    // Returns the encoder for the settings, creating it if no output uses a matching one.
+    static std::shared_ptr<Encoder> acquire(OutputSettings *settings, video_t *video, audio_t *audio,
+                                            obs_service_t *service);
+
+    static std::string getVideoEncoderId(OutputSettings *settings);
+
+    // Registers the output type measuring the video encoder latency, called once after obs_startup.
+    static void registerLatencyProbe();
+
+    Encoder(OutputSettings *settings, video_t *video, audio_t *audio, obs_service_t *service);
+
+    ~Encoder();
+
+    obs_encoder_t *getVideoEncoder();
+
+    obs_encoder_t *getAudioEncoder();
+
+    // Pushes a new bitrate into the running video encoder, returns false if the
+    // encoder can't change it live. The encoder isn't shared with new outputs afterwards.
+    bool setVideoBitrate(int bitrateKbps);
+
+    // Moving average of the time from a video frame's timestamp, when libobs rendered it, to its
+    // encoded packet, 0 without video. Only measured while an output using the encoder is connected.
+    uint64_t getAvgLatencyNs();
+
+    // Called by the outputs on connect and disconnect, the latency probe runs while one is connected
+    // and doesn't keep the encoder busy on its own.
+    void addConnectedOutput();
+
+    void removeConnectedOutput();
+
+private:
+    static std::string getKey(OutputSettings *settings, video_t *video, audio_t *audio);
+
+    static const char *probe_get_name(void *type_data);
+    static void *probe_create(obs_data_t *settings, obs_output_t *output);
+    static void probe_destroy(void *data);
+    static bool probe_start(void *data);
+    static void probe_stop(void *data, uint64_t ts);
+    static void probe_encoded_packet(void *data, encoder_packet *packet);
+
+    void createLatencyProbe();
+
+    static std::mutex mutex;
+    static std::map<std::string, std::weak_ptr<Encoder>> encoders;
+
+    std::string key;
+    obs_encoder_t *video_encoder;
+    obs_encoder_t *audio_encoder;
+
+    // a video only output on the same encoder, it gets every packet with its timestamps
+    obs_output_t *latency_probe;
+    std::mutex probe_mutex;
+    int connected_outputs;
+    std::atomic<uint64_t> avg_latency_ns;
+};
@@ -0,0 +1,85 @@
+#include "frame_pool.h"
+
+#define FRAME_POOL_MAX_SIZE 32
+
+FramePool::FramePool() :
+        mutex(),
+        frames(),
+        format(VIDEO_FORMAT_NONE),
+        width(0),
+        height(0),
+        hits(0),
+        misses(0) {
+}
+
+FramePool::~FramePool() {
+    clear();
+}
+
+obs_source_frame *FramePool::acquire(video_format f, uint32_t w, uint32_t h) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // geometry changed, frames of the old geometry are useless now
+    if (f != format || w != width || h != height) {
+        if (!frames.empty()) {
+            blog(LOG_INFO, "Frame pool shrink: %dx%d -> %dx%d, release %d frames",
+                 width, height, w, h, (int) frames.size());
+        }
+        for (auto frame : frames) {
+            obs_source_frame_destroy(frame);
+        }
+        frames.clear();
+        format = f;
+        width = w;
+        height = h;
+    }
+
+    if (!frames.empty()) {
+        obs_source_frame *frame = frames.back();
+        frames.pop_back();
+        hits++;
+        return frame;
+    }
+
+    misses++;
+    return obs_source_frame_create(f, w, h);
+}
+
+void FramePool::release(obs_source_frame *frame) {
+    if (!frame) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    if (matches(frame) && frames.size() < FRAME_POOL_MAX_SIZE) {
+        frames.push_back(frame);
+    } else {
+        obs_source_frame_destroy(frame);
+    }
+}
+
+void FramePool::clear() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (auto frame : frames) {
+        obs_source_frame_destroy(frame);
+    }
+    frames.clear();
+}
+
+uint64_t FramePool::getHits() {
+    std::unique_lock<std::mutex> lock(mutex);
+    return hits;
+}
+
+uint64_t FramePool::getMisses() {
+    std::unique_lock<std::mutex> lock(mutex);
+    return misses;
+}
+
+size_t FramePool::getSize() {
+    std::unique_lock<std::mutex> lock(mutex);
+    return frames.size();
+}
+
+bool FramePool::matches(obs_source_frame *frame) const {
+    return frame->format == format && frame->width == width && frame->height == height;
+}
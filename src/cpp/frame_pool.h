@@ -0,0 +1,37 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include <obs.h>
+
+// Recycles obs_source_frame buffers of a single format/width/height, so that
+// steady-state frame capture doesn't hit the allocator.
+class FramePool {
+
+public:
+    FramePool();
+    ~FramePool();
+
+    obs_source_frame *acquire(video_format format, uint32_t width, uint32_t height);
+
+    void release(obs_source_frame *frame);
+
+    void clear();
+
+    uint64_t getHits();
+
+    uint64_t getMisses();
+
+    size_t getSize();
+
+private:
+    bool matches(obs_source_frame *frame) const;
+
+    std::mutex mutex;
+    std::vector<obs_source_frame *> frames;
+    video_format format;
+    uint32_t width;
+    uint32_t height;
+    uint64_t hits;
+    uint64_t misses;
+};
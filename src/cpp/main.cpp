@@ -2,9 +2,11 @@
 #include "utils.h"
 #include "callback.h"
 #include "overlay.h"
+#include "transcoder_scheduler.h"
+#include "command_queue.h"
 #include <memory>
-#include <condition_variable>
 #include <napi.h>
+#include <util/platform.h>
 
 #ifdef __linux__
 // Need QT for linux to setup OpenGL properly.
@@ -16,6 +18,7 @@ QApplication *qApplication;
 Studio *studio = nullptr;
 Settings *settings = nullptr;
 Napi::ThreadSafeFunction volmeter_thread = nullptr;
+Napi::ThreadSafeFunction output_event_thread = nullptr;
 
 struct VolmeterData {
     std::string sceneId;
@@ -26,26 +29,101 @@ struct VolmeterData {
     std::vector<float> input_peak;
 };
 
+struct OutputEventData {
+    std::string outputId;
+    std::string event;
+    int code;
+    int attempt;
+};
+
+// Runs the command on the control thread, the promise settles on the main thread once it's done.
+Napi::Value queueCommand(const Napi::CallbackInfo &info, const char *name, std::function<void()> command) {
+    auto deferred = Napi::Promise::Deferred::New(info.Env());
+    auto tsfn = Napi::ThreadSafeFunction::New(
+            info.Env(),
+            Napi::Function::New(info.Env(), [](const Napi::CallbackInfo &info) {}),
+            name,
+            0,
+            1);
+
+    CommandQueue::getInstance().post([deferred, tsfn, command]() {
+        std::string error;
+        try {
+            command();
+        } catch (std::exception &e) {
+            error = e.what();
+        } catch (...) {
+            error = "Unexpected error.";
+        }
+        tsfn.BlockingCall([deferred, tsfn, error](Napi::Env env, Napi::Function jsCallback) {
+            if (error.empty()) {
+                deferred.Resolve(env.Undefined());
+            } else {
+                deferred.Reject(Napi::Error::New(env, error).Value());
+            }
+            (const_cast<Napi::ThreadSafeFunction&>(tsfn)).Release();
+        });
+    });
+
+    return deferred.Promise();
+}
+
 Napi::Value setObsPath(const Napi::CallbackInfo &info) {
     std::string obsPath = info[0].As<Napi::String>();
     Studio::setObsPath(obsPath);
     return info.Env().Undefined();
 }
 
+// settings and output ids are validated here, nothing is kept if they are invalid
+static void createStudio(const Napi::Object &object) {
+    auto studioSettings = new Settings(object);
+    try {
+        studio = new Studio(studioSettings);
+    } catch (...) {
+        delete studioSettings;
+        throw;
+    }
+    settings = studioSettings;
+}
+
 Napi::Value startup(const Napi::CallbackInfo &info) {
+    uint64_t start = os_gettime_ns();
 #ifdef __linux__
     int argc = 0;
     char **argv = nullptr;
     qApplication = new QApplication(argc, argv);
 #endif
-    settings = new Settings(info[0].As<Napi::Object>());
-    studio = new Studio(settings);
+    TRY_METHOD(createStudio(info[0].As<Napi::Object>()))
+    if (info.Env().IsExceptionPending()) {
+        return info.Env().Undefined();
+    }
     TRY_METHOD(studio->startup())
+    CommandQueue::getInstance().recordSync(os_gettime_ns() - start);
     return info.Env().Undefined();
 }
 
+Napi::Value startupAsync(const Napi::CallbackInfo &info) {
+#ifdef __linux__
+    // Qt has to be set up on the main thread
+    int argc = 0;
+    char **argv = nullptr;
+    qApplication = new QApplication(argc, argv);
+#endif
+    TRY_METHOD(createStudio(info[0].As<Napi::Object>()))
+    if (info.Env().IsExceptionPending()) {
+        return info.Env().Undefined();
+    }
+    return queueCommand(info, "Startup threadSafe function", [] {
+        studio->startup();
+    });
+}
+
 Napi::Value shutdown(const Napi::CallbackInfo &info) {
+    // queued commands still use the studio, let them finish first
+    CommandQueue::getInstance().drain();
     TRY_METHOD(studio->shutdown())
+    // relays of the sources being stopped may have posted their fallback meanwhile
+    CommandQueue::getInstance().drain();
 #ifdef __linux__
     delete qApplication;
 #endif
@@ -60,11 +138,39 @@ Napi::Value addScene(const Napi::CallbackInfo &info) {
     return info.Env().Undefined();
 }
 
+Napi::Value removeScene(const Napi::CallbackInfo &info) {
+    std::string sceneId = info[0].As<Napi::String>();
+    TRY_METHOD(studio->removeScene(sceneId))
+    return info.Env().Undefined();
+}
+
 Napi::Value addSource(const Napi::CallbackInfo &info) {
     std::string sceneId = info[0].As<Napi::String>();
     std::string sourceId = info[1].As<Napi::String>();
+    uint64_t start = os_gettime_ns();
     auto sourceSettings = std::make_shared<SourceSettings>(info[2].As<Napi::Object>());
     TRY_METHOD(studio->addSource(sceneId, sourceId, sourceSettings))
+    CommandQueue::getInstance().recordSync(os_gettime_ns() - start);
+    return info.Env().Undefined();
+}
+
+Napi::Value addSourceAsync(const Napi::CallbackInfo &info) {
+    std::string sceneId = info[0].As<Napi::String>();
+    std::string sourceId = info[1].As<Napi::String>();
+    std::shared_ptr<SourceSettings> sourceSettings;
+    TRY_METHOD(sourceSettings = std::make_shared<SourceSettings>(info[2].As<Napi::Object>()))
+    if (info.Env().IsExceptionPending()) {
+        return info.Env().Undefined();
+    }
+    return queueCommand(info, "AddSource threadSafe function", [sceneId, sourceId, sourceSettings]() mutable {
+        studio->addSource(sceneId, sourceId, sourceSettings);
+    });
+}
+
+Napi::Value removeSource(const Napi::CallbackInfo &info) {
+    std::string sceneId = info[0].As<Napi::String>();
+    std::string sourceId = info[1].As<Napi::String>();
+    TRY_METHOD(studio->removeSource(sceneId, sourceId))
     return info.Env().Undefined();
 }
 
@@ -73,28 +179,31 @@ Napi::Value updateSource(const Napi::CallbackInfo &info) {
     std::string sourceId = info[1].As<Napi::String>();
     auto request = info[2].As<Napi::Object>();
 
-    Source *source;
-    TRY_METHOD(source = studio->findSource(sceneId, sourceId))
-
+    // the url first, the restart resets the fader and audio settings
     auto url = request.Get("url");
     if (!url.IsUndefined()) {
-        TRY_METHOD(source->setUrl(url.As<Napi::String>()))
+        TRY_METHOD(studio->setSourceUrl(sceneId, sourceId, url.As<Napi::String>()))
+        if (info.Env().IsExceptionPending()) {
+            return info.Env().Undefined();
+        }
     }
 
-    auto volume = request.Get("volume");
-    if (!volume.IsUndefined()) {
-        TRY_METHOD(source->setVolume(volume.As<Napi::Number>()))
-    }
+    TRY_METHOD(studio->withSource(sceneId, sourceId, [&request](Source *source) {
+        auto volume = request.Get("volume");
+        if (!volume.IsUndefined()) {
+            source->setVolume(volume.As<Napi::Number>());
+        }
 
-    auto audioLock = request.Get("audioLock");
-    if (!audioLock.IsUndefined()) {
-        TRY_METHOD(source->setAudioLock(audioLock.As<Napi::Boolean>()))
-    }
+        auto audioLock = request.Get("audioLock");
+        if (!audioLock.IsUndefined()) {
+            source->setAudioLock(audioLock.As<Napi::Boolean>());
+        }
 
-    auto audioMonitor = request.Get("audioMonitor");
-    if (!audioMonitor.IsUndefined()) {
-        TRY_METHOD(source->setAudioMonitor(audioMonitor.As<Napi::Boolean>()))
-    }
+        auto audioMonitor = request.Get("audioMonitor");
+        if (!audioMonitor.IsUndefined()) {
+            source->setAudioMonitor(audioMonitor.As<Napi::Boolean>());
+        }
+    }))
 
     return info.Env().Undefined();
 }
@@ -103,18 +212,100 @@ Napi::Object getSource(const Napi::CallbackInfo &info) {
     std::string sceneId = info[0].As<Napi::String>();
     std::string sourceId = info[1].As<Napi::String>();
 
-    Source *source;
-    TRY_METHOD(source = studio->findSource(sceneId, sourceId))
+    auto result = Napi::Object::New(info.Env());
+    TRY_METHOD(studio->withSource(sceneId, sourceId, [&result](Source *source) {
+        result.Set("id", source->getId());
+        result.Set("sceneId", source->getSceneId());
+        result.Set("type", Source::getSourceTypeString(source->getType()));
+        result.Set("url", source->getUrl());
+        result.Set("volume", source->getVolume());
+        result.Set("audioLock", source->getAudioLock());
+        result.Set("audioMonitor", source->getAudioMonitor());
+    }))
+
+    return result;
+}
+
+Napi::Value getSourceStats(const Napi::CallbackInfo &info) {
+    std::string sceneId = info[0].As<Napi::String>();
+    std::string sourceId = info[1].As<Napi::String>();
+
+    // copied under the scene lock, the transcoder and relays go away with a restart or remove
+    bool hasStats = false;
+    TranscoderStats stats = {};
+    std::vector<SourceRelayStats> relays;
+    TRY_METHOD(studio->withSource(sceneId, sourceId, [&hasStats, &stats, &relays](Source *source) {
+        auto transcoder = source->getTranscoder();
+        // all outputs may be relayed, the transcoder counters stay zero then
+        if (transcoder) {
+            stats = transcoder->getStats();
+        }
+        for (auto relay : source->getRelays()) {
+            relays.push_back(relay->getStats());
+        }
+        hasStats = transcoder || !relays.empty();
+    }))
+    if (!hasStats) {
+        return info.Env().Undefined();
+    }
 
     auto result = Napi::Object::New(info.Env());
-    result.Set("id", source->getId());
-    result.Set("sceneId", source->getSceneId());
-    result.Set("type", Source::getSourceTypeString(source->getType()));
-    result.Set("url", source->getUrl());
-    result.Set("volume", source->getVolume());
-    result.Set("audioLock", source->getAudioLock());
-    result.Set("audioMonitor", source->getAudioMonitor());
+    result.Set("framePoolHits", stats.framePoolHits);
+    result.Set("framePoolMisses", stats.framePoolMisses);
+    result.Set("framePoolSize", stats.framePoolSize);
+    result.Set("frameLockContention", stats.frameLockContention);
+    result.Set("avgCaptureNs", stats.avgCaptureNs);
+    result.Set("avgSelectNs", stats.avgSelectNs);
+    result.Set("repeatedFrames", stats.repeatedFrames);
+    result.Set("scalersCreated", stats.scalersCreated);
+    result.Set("scalersEvicted", stats.scalersEvicted);
+    result.Set("audioOverflows", stats.audioOverflows);
+    result.Set("audioUnderruns", stats.audioUnderruns);
+    result.Set("driftPpm", stats.driftPpm);
+    result.Set("driftCorrections", stats.driftCorrections);
+
+    Napi::Array videos = Napi::Array::New(info.Env(), stats.videos.size());
+    for (size_t i = 0; i < stats.videos.size(); i++) {
+        auto video = Napi::Object::New(info.Env());
+        video.Set("width", stats.videos[i].width);
+        video.Set("height", stats.videos[i].height);
+        video.Set("format", stats.videos[i].format);
+        video.Set("scaleType", stats.videos[i].scaleType);
+        video.Set("renditions", stats.videos[i].renditions);
+        video.Set("frames", stats.videos[i].frames);
+        video.Set("passthroughFrames", stats.videos[i].passthroughFrames);
+        video.Set("slicedFrames", stats.videos[i].slicedFrames);
+        video.Set("avgConvertNs", stats.videos[i].avgConvertNs);
+        videos.Set(i, video);
+    }
+    result.Set("videos", videos);
+
+    Napi::Array relayStats = Napi::Array::New(info.Env(), relays.size());
+    for (size_t i = 0; i < relays.size(); i++) {
+        auto &relay = relays[i];
+        auto item = Napi::Object::New(info.Env());
+        item.Set("packets", relay.packets);
+        item.Set("bytes", relay.bytes);
+        item.Set("reconnects", relay.reconnects);
+        item.Set("transcoded", relay.transcoded);
+        relayStats.Set(i, item);
+    }
+    result.Set("relays", relayStats);
+
+    return result;
+}
 
+Napi::Object getSchedulerStats(const Napi::CallbackInfo &info) {
+    auto stats = TranscoderScheduler::getInstance().getStats();
+    auto result = Napi::Object::New(info.Env());
+    result.Set("clockThreads", stats.clockThreads);
+    result.Set("workerThreads", stats.workerThreads);
+    result.Set("transcoders", stats.transcoders);
+    result.Set("ticks", stats.ticks);
+    result.Set("lateTicks", stats.lateTicks);
+    result.Set("skippedTicks", stats.skippedTicks);
+    result.Set("avgJitterNs", stats.avgJitterNs);
+    result.Set("maxJitterNs", stats.maxJitterNs);
     return result;
 }
 
@@ -130,13 +321,133 @@ Napi::Value addDSK(const Napi::CallbackInfo &info) {
     return info.Env().Undefined();
 }
 
+Napi::Value updateDSK(const Napi::CallbackInfo &info) {
+    std::string id = info[0].As<Napi::String>();
+    std::string position = info[1].As<Napi::String>();
+    std::string url = info[2].As<Napi::String>();
+    int left = info[3].As<Napi::Number>();
+    int top = info[4].As<Napi::Number>();
+    int width = info[5].As<Napi::Number>();
+    int height = info[6].As<Napi::Number>();
+    TRY_METHOD(studio->updateDSK(id, position, url, left, top, width, height))
+    return info.Env().Undefined();
+}
+
+Napi::Value removeDSK(const Napi::CallbackInfo &info) {
+    std::string id = info[0].As<Napi::String>();
+    TRY_METHOD(studio->removeDSK(id))
+    return info.Env().Undefined();
+}
+
+Napi::Value addOutput(const Napi::CallbackInfo &info) {
+    std::string id = info[0].As<Napi::String>();
+    auto outputSettings = new OutputSettings(info[1].As<Napi::Object>());
+    outputSettings->id = id;
+    TRY_METHOD(studio->addOutput(outputSettings))
+    return info.Env().Undefined();
+}
+
+Napi::Value removeOutput(const Napi::CallbackInfo &info) {
+    std::string id = info[0].As<Napi::String>();
+    TRY_METHOD(studio->removeOutput(id))
+    return info.Env().Undefined();
+}
+
+Napi::Value updateOutput(const Napi::CallbackInfo &info) {
+    std::string id = info[0].As<Napi::String>();
+    auto request = info[1].As<Napi::Object>();
+
+    OutputUpdateResult updated;
+    TRY_METHOD(updated = studio->findOutput(id)->update(request))
+
+    auto result = Napi::Object::New(info.Env());
+    Napi::Array applied = Napi::Array::New(info.Env(), updated.applied.size());
+    for (size_t i = 0; i < updated.applied.size(); i++) {
+        applied.Set(i, updated.applied[i]);
+    }
+    Napi::Array restartRequired = Napi::Array::New(info.Env(), updated.restartRequired.size());
+    for (size_t i = 0; i < updated.restartRequired.size(); i++) {
+        restartRequired.Set(i, updated.restartRequired[i]);
+    }
+    result.Set("applied", applied);
+    result.Set("restartRequired", restartRequired);
+    return result;
+}
+
+Napi::Value restartOutput(const Napi::CallbackInfo &info) {
+    std::string id = info[0].As<Napi::String>();
+    TRY_METHOD(studio->restartOutput(id))
+    return info.Env().Undefined();
+}
+
+Napi::Value listOutputs(const Napi::CallbackInfo &info) {
+    auto outputs = studio->getOutputs();
+    Napi::Array result = Napi::Array::New(info.Env(), outputs.size());
+    int index = 0;
+    for (const auto &output : outputs) {
+        result.Set(index++, output.second->toNapiObject(info.Env()));
+    }
+    return result;
+}
+
+Napi::Value getOutputStats(const Napi::CallbackInfo &info) {
+    std::vector<OutputStats> stats;
+    TRY_METHOD(stats = studio->getOutputStats())
+
+    Napi::Array result = Napi::Array::New(info.Env(), stats.size());
+    for (size_t i = 0; i < stats.size(); i++) {
+        auto item = Napi::Object::New(info.Env());
+        item.Set("id", stats[i].id);
+        if (!stats[i].sourceId.empty()) {
+            item.Set("sceneId", stats[i].sceneId);
+            item.Set("sourceId", stats[i].sourceId);
+        }
+        item.Set("active", stats[i].active);
+        item.Set("totalBytes", stats[i].totalBytes);
+        item.Set("bitrateKbps", stats[i].bitrateKbps);
+        item.Set("totalFrames", stats[i].totalFrames);
+        item.Set("droppedFrames", stats[i].droppedFrames);
+        item.Set("skippedFrames", stats[i].skippedFrames);
+        item.Set("congestion", stats[i].congestion);
+        item.Set("connectTimeMs", stats[i].connectTimeMs);
+        item.Set("avgEncoderLatencyNs", stats[i].avgEncoderLatencyNs);
+        result.Set(i, item);
+    }
+    return result;
+}
+
 Napi::Value restartSource(const Napi::CallbackInfo &info) {
     std::string sceneId = info[0].As<Napi::String>();
     std::string sourceId = info[1].As<Napi::String>();
-    TRY_METHOD(studio->findSource(sceneId, sourceId)->restart())
+    uint64_t start = os_gettime_ns();
+    TRY_METHOD(studio->restartSource(sceneId, sourceId))
+    CommandQueue::getInstance().recordSync(os_gettime_ns() - start);
     return info.Env().Undefined();
 }
 
+Napi::Value restartSourceAsync(const Napi::CallbackInfo &info) {
+    std::string sceneId = info[0].As<Napi::String>();
+    std::string sourceId = info[1].As<Napi::String>();
+    return queueCommand(info, "RestartSource threadSafe function", [sceneId, sourceId]() mutable {
+        studio->restartSource(sceneId, sourceId);
+    });
+}
+
+Napi::Object getCommandStats(const Napi::CallbackInfo &info) {
+    auto stats = CommandQueue::getInstance().getStats();
+    auto result = Napi::Object::New(info.Env());
+    result.Set("commands", stats.commands);
+    result.Set("pending", stats.pending);
+    result.Set("lastRunNs", stats.lastRunNs);
+    result.Set("avgRunNs", stats.avgRunNs);
+    result.Set("maxRunNs", stats.maxRunNs);
+    result.Set("avgWaitNs", stats.avgWaitNs);
+    result.Set("syncCalls", stats.syncCalls);
+    result.Set("avgSyncBlockedNs", stats.avgSyncBlockedNs);
+    result.Set("maxSyncBlockedNs", stats.maxSyncBlockedNs);
+    return result;
+}
+
 Napi::Value switchToScene(const Napi::CallbackInfo &info) {
     std::string sceneId = info[0].As<Napi::String>();
     std::string transitionType = info[1].As<Napi::String>();
@@ -145,6 +456,59 @@ Napi::Value switchToScene(const Napi::CallbackInfo &info) {
     return info.Env().Undefined();
 }
 
+Napi::Value prepareScene(const Napi::CallbackInfo &info) {
+    std::string sceneId = info[0].As<Napi::String>();
+    int timeoutMs = info[1].IsUndefined() ? 10000 : info[1].As<Napi::Number>().Int32Value();
+
+    auto deferred = Napi::Promise::Deferred::New(info.Env());
+    auto tsfn = Napi::ThreadSafeFunction::New(
+            info.Env(),
+            Napi::Function::New(info.Env(), [](const Napi::CallbackInfo &info) {}),
+            "PrepareScene threadSafe function",
+            0,
+            1);
+
+    TRY_METHOD(studio->prepareScene(sceneId, timeoutMs, [deferred, tsfn](std::vector<std::string> &notReady) {
+        tsfn.BlockingCall([deferred, tsfn, notReady](Napi::Env env, Napi::Function jsCallback) {
+            auto result = Napi::Object::New(env);
+            result.Set("ready", notReady.empty());
+            Napi::Array pendingSources = Napi::Array::New(env, notReady.size());
+            for (size_t i = 0; i < notReady.size(); i++) {
+                pendingSources.Set(i, notReady[i]);
+            }
+            result.Set("pendingSources", pendingSources);
+            deferred.Resolve(result);
+            (const_cast<Napi::ThreadSafeFunction&>(tsfn)).Release();
+        });
+    }))
+    if (info.Env().IsExceptionPending()) {
+        tsfn.Release();
+        return info.Env().Undefined();
+    }
+
+    return deferred.Promise();
+}
+
+Napi::Value unprepareScene(const Napi::CallbackInfo &info) {
+    std::string sceneId = info[0].As<Napi::String>();
+    TRY_METHOD(studio->unprepareScene(sceneId))
+    return info.Env().Undefined();
+}
+
+Napi::Object getSceneSwitchStats(const Napi::CallbackInfo &info) {
+    auto stats = studio->getSceneSwitchStats();
+    auto result = Napi::Object::New(info.Env());
+    result.Set("switches", stats.switches);
+    result.Set("lastDispatchNs", stats.lastDispatchNs);
+    result.Set("avgDispatchNs", stats.avgDispatchNs);
+    result.Set("maxDispatchNs", stats.maxDispatchNs);
+    result.Set("completed", stats.completed);
+    result.Set("lastCompleteNs", stats.lastCompleteNs);
+    result.Set("avgCompleteNs", stats.avgCompleteNs);
+    result.Set("maxCompleteNs", stats.maxCompleteNs);
+    return result;
+}
+
 Napi::Value createDisplay(const Napi::CallbackInfo &info) {
     std::string displayName = info[0].As<Napi::String>();
     void *parentHandle = info[1].As<Napi::Buffer<void *>>().Data();
@@ -228,6 +592,46 @@ Napi::Value addVolmeterCallback(const Napi::CallbackInfo &info) {
     return info.Env().Undefined();
 }
 
+Napi::Value addOutputEventCallback(const Napi::CallbackInfo &info) {
+    auto callback = info[0].As<Napi::Function>();
+    output_event_thread = Napi::ThreadSafeFunction::New(
+            info.Env(),
+            callback,
+            "OutputEventThread",
+            0,
+            1
+    );
+
+    OutputEventCallback outputEventCallback = [](const std::string &outputId,
+                                                 const std::string &event,
+                                                 int code,
+                                                 int attempt) {
+        auto data = new OutputEventData {
+            .outputId = outputId,
+            .event = event,
+            .code = code,
+            .attempt = attempt,
+        };
+
+        auto callback = [](Napi::Env env, Napi::Function jsCallback, OutputEventData* data) {
+            jsCallback.Call({
+                Napi::String::New(env, data->outputId),
+                Napi::String::New(env, data->event),
+                Napi::Number::New(env, data->code),
+                Napi::Number::New(env, data->attempt)
+            });
+            delete data;
+        };
+
+        // events come from obs output threads which may be waited on by the js thread, never block
+        if (!output_event_thread || output_event_thread.NonBlockingCall(data, callback) != napi_ok) {
+            delete data;
+        }
+    };
+    TRY_METHOD(Callback::setOutputEventCallback(outputEventCallback))
+    return info.Env().Undefined();
+}
+
 Napi::Object getAudio(const Napi::CallbackInfo &info) {
     auto result = Napi::Object::New(info.Env());
     result.Set("masterVolume", studio->getMasterVolume());
@@ -260,8 +664,13 @@ Napi::Value screenshot(const Napi::CallbackInfo &info) {
     std::string sceneId = info[0].As<Napi::String>();
     std::string sourceId = info[1].As<Napi::String>();
 
-    Source *source;
-    TRY_METHOD(source = studio->findSource(sceneId, sourceId))
+    obs_source_t *obs_source = nullptr;
+    TRY_METHOD(studio->withSource(sceneId, sourceId, [&obs_source](Source *source) {
+        obs_source = obs_source_get_ref(source->getObsSource());
+    }))
+    if (info.Env().IsExceptionPending()) {
+        return info.Env().Undefined();
+    }
 
     auto deferred = Napi::Promise::Deferred::New(info.Env());
     auto tsfn = Napi::ThreadSafeFunction::New(
@@ -271,16 +680,13 @@ Napi::Value screenshot(const Napi::CallbackInfo &info) {
             0,
             1);
 
-    source->screenshot([deferred, tsfn](const uint8_t *data, size_t size) {
-        std::mutex mtx;
-        std::unique_lock<std::mutex> lock(mtx);
-        std::condition_variable cv;
-        tsfn.BlockingCall([deferred, tsfn, &cv, data, size](Napi::Env env, Napi::Function jsCallback) {
-            deferred.Resolve(Napi::Buffer<uint8_t>::Copy(env, data, size));
+    Source::screenshot(obs_source, [deferred, tsfn](const uint8_t *data, size_t size) {
+        // copied, the graphics thread doesn't wait for the main thread
+        auto png = std::make_shared<std::vector<uint8_t>>(data, data + size);
+        tsfn.NonBlockingCall([deferred, tsfn, png](Napi::Env env, Napi::Function jsCallback) {
+            deferred.Resolve(Napi::Buffer<uint8_t>::Copy(env, png->data(), png->size()));
             (const_cast<Napi::ThreadSafeFunction&>(tsfn)).Release();
-            cv.notify_one();
         });
-        cv.wait(lock);
     });
 
     return deferred.Promise();
@@ -323,18 +729,38 @@ Napi::Value getOverlays(const Napi::CallbackInfo &info) {
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
     exports.Set(Napi::String::New(env, "setObsPath"), Napi::Function::New(env, setObsPath));
     exports.Set(Napi::String::New(env, "startup"), Napi::Function::New(env, startup));
+    exports.Set(Napi::String::New(env, "startupAsync"), Napi::Function::New(env, startupAsync));
     exports.Set(Napi::String::New(env, "shutdown"), Napi::Function::New(env, shutdown));
     exports.Set(Napi::String::New(env, "addScene"), Napi::Function::New(env, addScene));
+    exports.Set(Napi::String::New(env, "removeScene"), Napi::Function::New(env, removeScene));
     exports.Set(Napi::String::New(env, "addSource"), Napi::Function::New(env, addSource));
+    exports.Set(Napi::String::New(env, "addSourceAsync"), Napi::Function::New(env, addSourceAsync));
+    exports.Set(Napi::String::New(env, "removeSource"), Napi::Function::New(env, removeSource));
     exports.Set(Napi::String::New(env, "getSource"), Napi::Function::New(env, getSource));
+    exports.Set(Napi::String::New(env, "getSourceStats"), Napi::Function::New(env, getSourceStats));
+    exports.Set(Napi::String::New(env, "getSchedulerStats"), Napi::Function::New(env, getSchedulerStats));
     exports.Set(Napi::String::New(env, "updateSource"), Napi::Function::New(env, updateSource));
     exports.Set(Napi::String::New(env, "restartSource"), Napi::Function::New(env, restartSource));
+    exports.Set(Napi::String::New(env, "restartSourceAsync"), Napi::Function::New(env, restartSourceAsync));
+    exports.Set(Napi::String::New(env, "getCommandStats"), Napi::Function::New(env, getCommandStats));
     exports.Set(Napi::String::New(env, "switchToScene"), Napi::Function::New(env, switchToScene));
+    exports.Set(Napi::String::New(env, "prepareScene"), Napi::Function::New(env, prepareScene));
+    exports.Set(Napi::String::New(env, "unprepareScene"), Napi::Function::New(env, unprepareScene));
+    exports.Set(Napi::String::New(env, "getSceneSwitchStats"), Napi::Function::New(env, getSceneSwitchStats));
     exports.Set(Napi::String::New(env, "createDisplay"), Napi::Function::New(env, createDisplay));
     exports.Set(Napi::String::New(env, "destroyDisplay"), Napi::Function::New(env, destroyDisplay));
     exports.Set(Napi::String::New(env, "moveDisplay"), Napi::Function::New(env, moveDisplay));
     exports.Set(Napi::String::New(env, "addDSK"), Napi::Function::New(env, addDSK));
+    exports.Set(Napi::String::New(env, "updateDSK"), Napi::Function::New(env, updateDSK));
+    exports.Set(Napi::String::New(env, "removeDSK"), Napi::Function::New(env, removeDSK));
+    exports.Set(Napi::String::New(env, "addOutput"), Napi::Function::New(env, addOutput));
+    exports.Set(Napi::String::New(env, "removeOutput"), Napi::Function::New(env, removeOutput));
+    exports.Set(Napi::String::New(env, "updateOutput"), Napi::Function::New(env, updateOutput));
+    exports.Set(Napi::String::New(env, "restartOutput"), Napi::Function::New(env, restartOutput));
+    exports.Set(Napi::String::New(env, "getOutputStats"), Napi::Function::New(env, getOutputStats));
+    exports.Set(Napi::String::New(env, "listOutputs"), Napi::Function::New(env, listOutputs));
     exports.Set(Napi::String::New(env, "addVolmeterCallback"), Napi::Function::New(env, addVolmeterCallback));
+    exports.Set(Napi::String::New(env, "addOutputEventCallback"), Napi::Function::New(env, addOutputEventCallback));
     exports.Set(Napi::String::New(env, "getAudio"), Napi::Function::New(env, getAudio));
     exports.Set(Napi::String::New(env, "updateAudio"), Napi::Function::New(env, updateAudio));
     exports.Set(Napi::String::New(env, "screenshot"), Napi::Function::New(env, screenshot));
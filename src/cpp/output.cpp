@@ -1,59 +1,51 @@
 #include "output.h"
+#include "audio_only_output.h"
 #include "studio.h"
+#include "utils.h"
+#include "callback.h"
+#include <algorithm>
+#include <util/platform.h>
+
+#define ADAPTIVE_INTERVAL_MS 2000
+#define ADAPTIVE_CONGESTION_HIGH 0.5f
+#define ADAPTIVE_CONGESTION_LOW 0.1f
+#define ADAPTIVE_DROP_RATIO 0.01
+#define ADAPTIVE_STABLE_INTERVALS 5
+#define RETRY_MAX_DELAY_SEC 900
 
 Output::Output(OutputSettings *settings) :
         settings(settings),
-        video_encoder(nullptr),
-        audio_encoder(nullptr),
+        encoder(),
         output_service(nullptr),
-        output(nullptr) {
+        output(nullptr),
+        video(nullptr),
+        stats_mutex(),
+        stats_bytes(0),
+        stats_time(0),
+        stats_bitrate(0),
+        bitrate_mutex(),
+        pending_settings(),
+        video_bitrate(settings ? settings->videoBitrateKbps : 0),
+        bitrate_changes(0),
+        adaptive_thread(),
+        adaptive_mutex(),
+        adaptive_cv(),
+        adaptive_stop(false),
+        retry_thread(),
+        retry_mutex(),
+        retry_cv(),
+        retry_stop(false),
+        retry_at(0),
+        retry_attempts(0),
+        connected(false),
+        encoder_connected(false) {
 }
 
-void Output::start(video_t *video, audio_t *audio) {
+void Output::start(video_t *v, audio_t *audio) {
     if (!settings) {
         return;
     }
-
-    // video encoder
-    std::string encoder = settings->hardwareEnable ? "ffmpeg_nvenc" : "obs_x264";
-    video_encoder = obs_video_encoder_create(encoder.c_str(), "h264 enc", nullptr, nullptr);
-    if (!video_encoder) {
-        throw std::runtime_error("Failed to create video encoder.");
-    }
-
-    obs_data_t *video_encoder_settings = obs_encoder_get_settings(video_encoder);
-    if (!video_encoder_settings) {
-        throw std::runtime_error("Failed to get video encoder settings.");
-    }
-
-    obs_data_set_int(video_encoder_settings, "keyint_sec", settings->keyintSec);
-    obs_data_set_string(video_encoder_settings, "rate_control", settings->rateControl.c_str());
-    obs_data_set_int(video_encoder_settings, "width", settings->width);
-    obs_data_set_int(video_encoder_settings, "height", settings->height);
-    obs_data_set_string(video_encoder_settings, "preset", settings->preset.c_str());
-    obs_data_set_string(video_encoder_settings, "profile", settings->profile.c_str());
-    obs_data_set_string(video_encoder_settings, "tune", settings->tune.c_str());
-    obs_data_set_string(video_encoder_settings, "x264opts", settings->x264opts.c_str());
-    obs_data_set_int(video_encoder_settings, "bitrate", settings->videoBitrateKbps);
-
-    obs_encoder_update(video_encoder, video_encoder_settings);
-    obs_encoder_set_scaled_size(video_encoder, settings->width, settings->height);
-    obs_encoder_set_video(video_encoder, video);
-
-    // audio encoder
-    audio_encoder = obs_audio_encoder_create("ffmpeg_aac", "aac enc", nullptr, 0, nullptr);
-    if (!audio_encoder) {
-        throw std::runtime_error("Failed to create audio encoder.");
-    }
-
-    obs_data_t *audio_encoder_settings = obs_encoder_get_settings(audio_encoder);
-    if (!audio_encoder_settings) {
-        throw std::runtime_error("Failed to get audio encoder settings.");
-    }
-
-    obs_data_set_int(audio_encoder_settings, "bitrate", settings->audioBitrateKbps);
-    obs_encoder_update(audio_encoder, audio_encoder_settings);
-    obs_encoder_set_audio(audio_encoder, audio);
+    video = settings->audioOnly ? nullptr : v;
 
     // output service
     bool is_rtmp = settings->server.rfind("rtmp", 0) == 0;
@@ -79,12 +71,15 @@ void Output::start(video_t *video, audio_t *audio) {
     }
 
     obs_service_update(output_service, output_service_settings);
-    obs_service_apply_encoder_settings(output_service, video_encoder_settings, audio_encoder_settings);
-    obs_data_release(video_encoder_settings);
-    obs_data_release(audio_encoder_settings);
+    obs_data_release(output_service_settings);
 
-    // output
-    if (is_rtmp) {
+    // encoders, shared with the other outputs encoding the same thing
+    encoder = Encoder::acquire(settings, video, audio, output_service);
+
+    // output, the rtmp and mpegts outputs can't start without video
+    if (settings->audioOnly) {
+        output = obs_output_create(AudioOnlyOutput::id, "audio only output", nullptr, nullptr);
+    } else if (is_rtmp) {
         output = obs_output_create("rtmp_output", "rtmp output", nullptr, nullptr);
     } else {
         output = obs_output_create("ffmpeg_mpegts_muxer", "ffmpeg mpegts muxer output", nullptr, nullptr);
@@ -100,27 +95,413 @@ void Output::start(video_t *video, audio_t *audio) {
         throw std::runtime_error("Failed to create output.");
     }
 
-    if (video_encoder) {
-        obs_output_set_video_encoder(output, video_encoder);
+    if (encoder->getVideoEncoder()) {
+        obs_output_set_video_encoder(output, encoder->getVideoEncoder());
     }
 
-    if (audio_encoder) {
-        obs_output_set_audio_encoder(output, audio_encoder, 0);
+    if (encoder->getAudioEncoder()) {
+        obs_output_set_audio_encoder(output, encoder->getAudioEncoder(), 0);
     }
 
     obs_output_set_service(output, output_service);
+    obs_output_set_reconnect_settings(output, settings->reconnectMaxRetries, settings->reconnectDelaySec);
+
+    signal_handler_t *handler = obs_output_get_signal_handler(output);
+    signal_handler_connect(handler, "start", output_start_callback, this);
+    signal_handler_connect(handler, "stop", output_stop_callback, this);
+    signal_handler_connect(handler, "reconnect", output_reconnect_callback, this);
+    signal_handler_connect(handler, "reconnect_success", output_reconnect_success_callback, this);
+
+    {
+        std::unique_lock<std::mutex> lock(stats_mutex);
+        stats_time = 0;
+        stats_bitrate = 0;
+    }
+    connected = false;
+    retry_stop = false;
+    retry_at = 0;
+    retry_attempts = 0;
+    if (settings->reconnectMaxRetries > 0) {
+        retry_thread = std::thread(&Output::runRetry, this);
+    }
 
     if (!obs_output_start(output)) {
-        throw std::runtime_error("Failed to start output.");
+        blog(LOG_ERROR, "Output %s failed to start: %s", settings->id.c_str(), obs_output_get_last_error(output));
+        if (!scheduleRetry()) {
+            throw std::runtime_error("Failed to start output.");
+        }
+    }
+
+    video_bitrate = settings->videoBitrateKbps;
+    if (settings->adaptiveBitrate && is_rtmp) {
+        adaptive_stop = false;
+        adaptive_thread = std::thread(&Output::runAdaptiveBitrate, this);
     }
 }
 
 void Output::stop() {
+    if (retry_thread.joinable()) {
+        {
+            std::unique_lock<std::mutex> lock(retry_mutex);
+            retry_stop = true;
+        }
+        retry_cv.notify_all();
+        retry_thread.join();
+    }
+    if (adaptive_thread.joinable()) {
+        {
+            std::unique_lock<std::mutex> lock(adaptive_mutex);
+            adaptive_stop = true;
+        }
+        adaptive_cv.notify_all();
+        adaptive_thread.join();
+    }
     if (output) {
+        // the stop signal may come after the output is gone, report the stop here instead
+        signal_handler_t *handler = obs_output_get_signal_handler(output);
+        signal_handler_disconnect(handler, "start", output_start_callback, this);
+        signal_handler_disconnect(handler, "stop", output_stop_callback, this);
+        signal_handler_disconnect(handler, "reconnect", output_reconnect_callback, this);
+        signal_handler_disconnect(handler, "reconnect_success", output_reconnect_success_callback, this);
+        setEncoderConnected(false);
         obs_output_stop(output);
-        obs_encoder_release(video_encoder);
-        obs_encoder_release(audio_encoder);
         obs_output_release(output);
+        emitEvent("stop", OBS_OUTPUT_SUCCESS, 0);
+        output = nullptr;
+    }
+    // each on its own, a failed start may have created the service or the encoder only
+    encoder = nullptr;
+    if (output_service) {
         obs_service_release(output_service);
+        output_service = nullptr;
+    }
+    video = nullptr;
+}
+
+
+video_format Output::getVideoFormat() {
+    if (settings->videoFormat.empty()) {
+        // nvenc takes nv12, x264 encodes from i420 planes directly
+        return Encoder::getVideoEncoderId(settings) == "ffmpeg_nvenc" ? VIDEO_FORMAT_NV12 : VIDEO_FORMAT_I420;
+    } else if (settings->videoFormat == "NV12") {
+        return VIDEO_FORMAT_NV12;
+    } else if (settings->videoFormat == "I420") {
+        return VIDEO_FORMAT_I420;
+    } else if (settings->videoFormat == "BGRA") {
+        return VIDEO_FORMAT_BGRA;
+    } else {
+        throw std::invalid_argument("Invalid videoFormat: " + settings->videoFormat);
+    }
+}
+
+video_scale_type Output::getScaleType() {
+    if (settings->scaleType == "fastBilinear") {
+        return VIDEO_SCALE_FAST_BILINEAR;
+    } else if (settings->scaleType == "point") {
+        return VIDEO_SCALE_POINT;
+    } else if (settings->scaleType == "bilinear") {
+        return VIDEO_SCALE_BILINEAR;
+    } else if (settings->scaleType == "bicubic") {
+        return VIDEO_SCALE_BICUBIC;
+    } else {
+        throw std::invalid_argument("Invalid scaleType: " + settings->scaleType);
+    }
+}
+
+void Output::output_start_callback(void *param, calldata_t *data) {
+    UNUSED_PARAMETER(data);
+    auto output = (Output *) param;
+    {
+        std::unique_lock<std::mutex> lock(output->retry_mutex);
+        output->retry_attempts = 0;
+    }
+    output->connected = true;
+    output->setEncoderConnected(true);
+    output->emitEvent("connect", OBS_OUTPUT_SUCCESS, 0);
+}
+
+void Output::output_stop_callback(void *param, calldata_t *data) {
+    auto output = (Output *) param;
+    int code = (int) calldata_int(data, "code");
+    bool was_connected = output->connected.exchange(false);
+    output->setEncoderConnected(false);
+    if (code == OBS_OUTPUT_SUCCESS) {
+        output->emitEvent("stop", code, 0);
+        return;
+    }
+
+    blog(LOG_WARNING, "Output %s stopped with code %d: %s", output->settings->id.c_str(), code,
+         obs_output_get_last_error(output->output));
+    // a connection that never came up isn't retried by libobs
+    if (!was_connected && output->scheduleRetry()) {
+        return;
+    }
+    output->emitEvent("disconnect", code, 0);
+}
+
+void Output::output_reconnect_callback(void *param, calldata_t *data) {
+    UNUSED_PARAMETER(data);
+    auto output = (Output *) param;
+    output->connected = false;
+    output->setEncoderConnected(false);
+    int attempt;
+    {
+        std::unique_lock<std::mutex> lock(output->retry_mutex);
+        attempt = ++output->retry_attempts;
     }
+    output->emitEvent("reconnect", OBS_OUTPUT_DISCONNECTED, attempt);
+}
+
+void Output::output_reconnect_success_callback(void *param, calldata_t *data) {
+    UNUSED_PARAMETER(data);
+    auto output = (Output *) param;
+    int attempt;
+    {
+        std::unique_lock<std::mutex> lock(output->retry_mutex);
+        attempt = output->retry_attempts;
+        output->retry_attempts = 0;
+    }
+    output->connected = true;
+    output->setEncoderConnected(true);
+    output->emitEvent("reconnectSuccess", OBS_OUTPUT_SUCCESS, attempt);
+}
+
+bool Output::scheduleRetry() {
+    int attempt;
+    int delay;
+    {
+        std::unique_lock<std::mutex> lock(retry_mutex);
+        if (retry_stop || !retry_thread.joinable() || retry_attempts >= settings->reconnectMaxRetries) {
+            return false;
+        }
+        attempt = ++retry_attempts;
+        // same backoff as libobs reconnects, doubling from the configured delay
+        delay = std::min(settings->reconnectDelaySec << std::min(attempt - 1, 16), RETRY_MAX_DELAY_SEC);
+        retry_at = os_gettime_ns() + (uint64_t) delay * 1000000000;
+    }
+    retry_cv.notify_all();
+    blog(LOG_INFO, "Output %s retries in %ds, attempt %d", settings->id.c_str(), delay, attempt);
+    emitEvent("reconnect", OBS_OUTPUT_CONNECT_FAILED, attempt);
+    return true;
+}
+
+void Output::runRetry() {
+    std::unique_lock<std::mutex> lock(retry_mutex);
+    while (!retry_stop) {
+        if (!retry_at) {
+            retry_cv.wait(lock);
+            continue;
+        }
+        uint64_t now = os_gettime_ns();
+        if (now < retry_at) {
+            retry_cv.wait_for(lock, std::chrono::nanoseconds(retry_at - now));
+            continue;
+        }
+        retry_at = 0;
+
+        // encoders and service stay as they are, only the connection is made again
+        lock.unlock();
+        bool started = obs_output_start(output);
+        if (!started) {
+            blog(LOG_ERROR, "Output %s failed to start: %s", settings->id.c_str(), obs_output_get_last_error(output));
+            if (!scheduleRetry()) {
+                emitEvent("disconnect", OBS_OUTPUT_ERROR, 0);
+            }
+        }
+        lock.lock();
+    }
+}
+
+void Output::setEncoderConnected(bool value) {
+    if (encoder && encoder_connected.exchange(value) != value) {
+        value ? encoder->addConnectedOutput() : encoder->removeConnectedOutput();
+    }
+}
+
+void Output::emitEvent(const std::string &event, int code, int attempt) {
+    auto callback = Callback::getOutputEventCallback();
+    if (callback) {
+        callback(settings->id, event, code, attempt);
+    }
+}
+
+void Output::runAdaptiveBitrate() {
+    uint64_t last_bytes = obs_output_get_total_bytes(output);
+    int last_frames = obs_output_get_total_frames(output);
+    int last_dropped = obs_output_get_frames_dropped(output);
+    int stable_intervals = 0;
+
+    std::unique_lock<std::mutex> lock(adaptive_mutex);
+    while (!adaptive_cv.wait_for(lock, std::chrono::milliseconds(ADAPTIVE_INTERVAL_MS), [this] { return adaptive_stop; })) {
+        uint64_t bytes = obs_output_get_total_bytes(output);
+        int frames = obs_output_get_total_frames(output);
+        int dropped = obs_output_get_frames_dropped(output);
+        float congestion = obs_output_get_congestion(output);
+
+        int interval_frames = frames - last_frames;
+        int interval_dropped = dropped - last_dropped;
+        auto sent_kbps = (int) ((bytes - last_bytes) * 8 / ADAPTIVE_INTERVAL_MS);
+        last_bytes = bytes;
+        last_frames = frames;
+        last_dropped = dropped;
+
+        if (!obs_output_active(output) || interval_frames <= 0) {
+            // not connected, nothing to measure
+            stable_intervals = 0;
+            continue;
+        }
+
+        // a shared encoder feeds other outputs too, it must not change under them
+        if (encoder.use_count() > 1) {
+            continue;
+        }
+
+        // updateOutput may set a bitrate and a new ceiling meanwhile
+        std::unique_lock<std::mutex> bitrate_lock(bitrate_mutex);
+        int bitrate = video_bitrate;
+        int target = bitrate;
+        double drop_ratio = (double) interval_dropped / (interval_frames + interval_dropped);
+        if (congestion > ADAPTIVE_CONGESTION_HIGH || drop_ratio > ADAPTIVE_DROP_RATIO) {
+            // step down, straight to what actually got through if that's lower, but at most by half
+            int throughput = sent_kbps - settings->audioBitrateKbps;
+            target = std::min(bitrate - settings->adaptiveStepKbps, std::max(throughput, bitrate / 2));
+            stable_intervals = 0;
+        } else if (congestion < ADAPTIVE_CONGESTION_LOW && interval_dropped == 0) {
+            if (++stable_intervals >= ADAPTIVE_STABLE_INTERVALS) {
+                target = bitrate + settings->adaptiveStepKbps;
+                stable_intervals = 0;
+            }
+        } else {
+            stable_intervals = 0;
+        }
+        target = std::clamp(target, settings->adaptiveMinKbps, settings->adaptiveMaxKbps);
+
+        if (target != bitrate && encoder->setVideoBitrate(target)) {
+            blog(LOG_INFO, "Output %s adaptive bitrate %d -> %dkbps, congestion %.2f, dropped %d/%d, sent %dkbps",
+                 settings->id.c_str(), bitrate, target, congestion, interval_dropped, interval_frames, sent_kbps);
+            video_bitrate = target;
+            bitrate_changes++;
+        }
+    }
+}
+
+OutputStats Output::getStats() {
+    OutputStats stats = {};
+    stats.id = settings->id;
+    if (!output) {
+        return stats;
+    }
+
+    stats.active = obs_output_active(output);
+    stats.totalBytes = obs_output_get_total_bytes(output);
+    stats.totalFrames = obs_output_get_total_frames(output);
+    stats.droppedFrames = obs_output_get_frames_dropped(output);
+    stats.congestion = obs_output_get_congestion(output);
+    stats.connectTimeMs = obs_output_get_connect_time_ms(output);
+    // frames the encoder didn't keep up with, dropped frames are the network's
+    stats.skippedFrames = video ? video_output_get_skipped_frames(video) : 0;
+
+    stats.avgEncoderLatencyNs = encoder ? encoder->getAvgLatencyNs() : 0;
+
+    std::unique_lock<std::mutex> lock(stats_mutex);
+    uint64_t now = os_gettime_ns();
+    if (!stats_time || stats.totalBytes < stats_bytes) {
+        stats_bytes = stats.totalBytes;
+        stats_time = now;
+    } else if (now - stats_time >= OUTPUT_STATS_WINDOW) {
+        stats_bitrate = (int) ((stats.totalBytes - stats_bytes) * 8000000 / (now - stats_time));
+        stats_bytes = stats.totalBytes;
+        stats_time = now;
+    }
+    stats.bitrateKbps = stats_bitrate;
+    return stats;
+}
+
+OutputUpdateResult Output::update(const Napi::Object &request) {
+    OutputUpdateResult result;
+
+    if (request.Has("videoBitrateKbps")) {
+        std::unique_lock<std::mutex> lock(bitrate_mutex);
+        settings->videoBitrateKbps = getNapiInt(request, "videoBitrateKbps");
+        // an explicit bitrate is the new ceiling, adaptation only steps down from it
+        if (settings->adaptiveBitrate) {
+            settings->adaptiveMaxKbps = settings->videoBitrateKbps;
+            settings->adaptiveMinKbps = std::min(settings->adaptiveMinKbps, settings->videoBitrateKbps);
+        }
+        // a shared encoder feeds other outputs too, it must not change under them
+        bool live = output && encoder && encoder.use_count() == 1 && encoder->setVideoBitrate(settings->videoBitrateKbps);
+        if (live) {
+            video_bitrate = settings->videoBitrateKbps;
+        }
+        (live ? result.applied : result.restartRequired).push_back("videoBitrateKbps");
+    }
+
+    // the running output keeps its settings, listOutputs and the stats report what it's really doing
+    std::unique_lock<std::mutex> lock(bitrate_mutex);
+    auto pending = [&]() -> OutputSettings & {
+        if (!pending_settings) {
+            pending_settings = std::make_unique<OutputSettings>(*settings);
+        }
+        return *pending_settings;
+    };
+    auto updateInt = [&](const char *name, int OutputSettings::*field) {
+        if (request.Has(name)) {
+            pending().*field = getNapiInt(request, name);
+            result.restartRequired.push_back(name);
+        }
+    };
+    auto updateString = [&](const char *name, std::string OutputSettings::*field) {
+        if (request.Has(name)) {
+            pending().*field = getNapiString(request, name);
+            result.restartRequired.push_back(name);
+        }
+    };
+    updateString("server", &OutputSettings::server);
+    updateString("key", &OutputSettings::key);
+    updateInt("width", &OutputSettings::width);
+    updateInt("height", &OutputSettings::height);
+    updateInt("keyintSec", &OutputSettings::keyintSec);
+    updateString("rateControl", &OutputSettings::rateControl);
+    updateString("preset", &OutputSettings::preset);
+    updateString("profile", &OutputSettings::profile);
+    updateString("tune", &OutputSettings::tune);
+    updateString("x264opts", &OutputSettings::x264opts);
+    updateInt("audioBitrateKbps", &OutputSettings::audioBitrateKbps);
+
+    return result;
+}
+
+void Output::restart(video_t *v, audio_t *audio) {
+    stop();
+    {
+        std::unique_lock<std::mutex> lock(bitrate_mutex);
+        if (pending_settings) {
+            settings->server = pending_settings->server;
+            settings->key = pending_settings->key;
+            settings->width = pending_settings->width;
+            settings->height = pending_settings->height;
+            settings->keyintSec = pending_settings->keyintSec;
+            settings->rateControl = pending_settings->rateControl;
+            settings->preset = pending_settings->preset;
+            settings->profile = pending_settings->profile;
+            settings->tune = pending_settings->tune;
+            settings->x264opts = pending_settings->x264opts;
+            settings->audioBitrateKbps = pending_settings->audioBitrateKbps;
+            pending_settings.reset();
+        }
+    }
+    start(v, audio);
+}
+
+Napi::Object Output::toNapiObject(Napi::Env env) {
+    auto result = Napi::Object::New(env);
+    result.Set("id", settings->id);
+    result.Set("server", settings->server);
+    result.Set("audioOnly", settings->audioOnly);
+    result.Set("active", output != nullptr && obs_output_active(output));
+    result.Set("videoBitrateKbps", (int) video_bitrate);
+    result.Set("bitrateChanges", (uint64_t) bitrate_changes);
+    std::unique_lock<std::mutex> lock(bitrate_mutex);
+    result.Set("restartPending", pending_settings != nullptr);
+    return result;
 }
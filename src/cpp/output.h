@@ -1,6 +1,37 @@
 #pragma once
 #include <obs.h>
+#include <media-io/video-scaler.h>
 #include "settings.h"
+#include "encoder.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define OUTPUT_STATS_WINDOW 2000000000
+
+struct OutputUpdateResult {
+    std::vector<std::string> applied;
+    std::vector<std::string> restartRequired;
+};
+
+struct OutputStats {
+    std::string id;
+    std::string sceneId;
+    std::string sourceId;
+    bool active;
+    uint64_t totalBytes;
+    int bitrateKbps;
+    int totalFrames;
+    int droppedFrames;
+    uint32_t skippedFrames;
+    float congestion;
+    int connectTimeMs;
+    uint64_t avgEncoderLatencyNs;
+};
 
 class Output {
 
@@ -10,10 +41,71 @@ public:
     void start(video_t *video, audio_t *audio);
     void stop();
 
+    // Raw video format the encoder consumes natively, used for outputs we open ourselves.
+    video_format getVideoFormat();
+
+    video_scale_type getScaleType();
+
+    // Updates the output settings, the fields that can't be applied to the running
+    // output are kept apart and take effect on restart().
+    OutputUpdateResult update(const Napi::Object &request);
+
+    // Stops the output, applies the pending settings of update() and starts it again.
+    void restart(video_t *video, audio_t *audio);
+
+    // Cheap enough to poll every second, the bitrate is averaged over windows of at least
+    // OUTPUT_STATS_WINDOW so that several pollers don't shorten each other's interval.
+    OutputStats getStats();
+
+    Napi::Object toNapiObject(Napi::Env env);
+
 private:
+    static void output_start_callback(void *param, calldata_t *data);
+    static void output_stop_callback(void *param, calldata_t *data);
+    static void output_reconnect_callback(void *param, calldata_t *data);
+    static void output_reconnect_success_callback(void *param, calldata_t *data);
+
+    void runAdaptiveBitrate();
+
+    void runRetry();
+
+    bool scheduleRetry();
+
+    void emitEvent(const std::string &event, int code, int attempt);
+
+    // tells the encoder whether this output is connected, it measures its latency only then
+    void setEncoderConnected(bool value);
+
     OutputSettings *settings;
-    obs_encoder_t *video_encoder;
-    obs_encoder_t *audio_encoder;
+    std::shared_ptr<Encoder> encoder;
     obs_service_t *output_service;
     obs_output_t *output;
+    video_t *video;
+
+    std::mutex stats_mutex;
+    uint64_t stats_bytes;
+    uint64_t stats_time;
+    int stats_bitrate;
+
+    // serializes the encoder bitrate changes of the adaptive thread and update(),
+    // and guards the settings the adaptive thread reads
+    std::mutex bitrate_mutex;
+    // restart-only fields from update(), null when there are none
+    std::unique_ptr<OutputSettings> pending_settings;
+    std::atomic<int> video_bitrate;
+    std::atomic<uint64_t> bitrate_changes;
+    std::thread adaptive_thread;
+    std::mutex adaptive_mutex;
+    std::condition_variable adaptive_cv;
+    bool adaptive_stop;
+
+    // initial connects are retried here, libobs reconnects dropped connections itself
+    std::thread retry_thread;
+    std::mutex retry_mutex;
+    std::condition_variable retry_cv;
+    bool retry_stop;
+    uint64_t retry_at;
+    int retry_attempts;
+    std::atomic<bool> connected;
+    std::atomic<bool> encoder_connected;
 };
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "scale_slices.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+// Band edges and margins are multiples of this many output rows, which keeps the rows of 4:2:0
+// chroma planes and the 8 row dither pattern of swscale on the same phase as the full frame.
+#define SCALE_SLICE_ALIGN 16
+// Input rows each margin covers at least, wider than the support of the bicubic filter.
+#define SCALE_SLICE_MIN_INPUT_MARGIN 8
+
+int get_planes(enum video_format format, uint32_t width, uint32_t height, plane_info *planes) {
+    switch (format) {
+        case VIDEO_FORMAT_I420:
+            planes[0] = {width, height};
+            planes[1] = {(width + 1) / 2, (height + 1) / 2};
+            planes[2] = {(width + 1) / 2, (height + 1) / 2};
+            return 3;
+        case VIDEO_FORMAT_NV12:
+            planes[0] = {width, height};
+            planes[1] = {(width + 1) / 2 * 2, (height + 1) / 2};
+            return 2;
+        case VIDEO_FORMAT_I422:
+            planes[0] = {width, height};
+            planes[1] = {(width + 1) / 2, height};
+            planes[2] = {(width + 1) / 2, height};
+            return 3;
+        case VIDEO_FORMAT_I444:
+            planes[0] = {width, height};
+            planes[1] = {width, height};
+            planes[2] = {width, height};
+            return 3;
+        case VIDEO_FORMAT_Y800:
+            planes[0] = {width, height};
+            return 1;
+        case VIDEO_FORMAT_YVYU:
+        case VIDEO_FORMAT_YUY2:
+        case VIDEO_FORMAT_UYVY:
+            planes[0] = {width * 2, height};
+            return 1;
+        case VIDEO_FORMAT_BGR3:
+            planes[0] = {width * 3, height};
+            return 1;
+        case VIDEO_FORMAT_RGBA:
+        case VIDEO_FORMAT_BGRA:
+        case VIDEO_FORMAT_BGRX:
+            planes[0] = {width * 4, height};
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+std::vector<ScaleSlice> plan_scale_slices(uint32_t in_height, uint32_t out_height, size_t max_slices) {
+    std::vector<ScaleSlice> slices;
+    if (max_slices < 2 || in_height == 0 || out_height == 0 || in_height % 2 || out_height % 2) {
+        return slices;
+    }
+
+    // swscale steps (in_height << 16) / out_height input rows per output row. A band only starts
+    // on the same filter phase as the full frame if that step is exact, which needs the reduced
+    // out / in ratio to have a power of two denominator.
+    uint64_t g = std::gcd(in_height, out_height);
+    uint64_t p = in_height / g;
+    uint64_t q = out_height / g;
+    if ((q & (q - 1)) != 0 || q > 65536) {
+        return slices;
+    }
+
+    // band edges in output rows, mapping to even input rows
+    uint64_t unit = std::lcm<uint64_t>(SCALE_SLICE_ALIGN, q);
+    if ((unit * p / q) % 2) {
+        unit *= 2;
+    }
+    uint64_t margin = unit;
+    while (margin * p / q < SCALE_SLICE_MIN_INPUT_MARGIN) {
+        margin += unit;
+    }
+
+    uint64_t units = out_height / unit;
+    size_t count = (size_t) std::min<uint64_t>(max_slices, units);
+    if (count < 2) {
+        return slices;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        uint64_t begin = unit * (units * i / count);
+        uint64_t end = i + 1 == count ? out_height : unit * (units * (i + 1) / count);
+        uint64_t top = std::min(margin, begin);
+        uint64_t bottom = std::min<uint64_t>(margin, out_height - end);
+        uint64_t out_begin = begin - top;
+        uint64_t out_end = end + bottom;
+
+        ScaleSlice slice = {};
+        slice.in_row = (uint32_t) (out_begin * p / q);
+        slice.in_rows = (uint32_t) ((out_end == out_height ? in_height : out_end * p / q) - slice.in_row);
+        slice.out_row = (uint32_t) begin;
+        slice.out_rows = (uint32_t) (out_end - out_begin);
+        slice.skip = (uint32_t) top;
+        slice.keep = (uint32_t) (end - begin);
+        slices.push_back(slice);
+    }
+    return slices;
+}
+
+bool create_scale_slices(std::vector<ScaleSliceScaler> &slices, const struct video_scale_info *dest,
+                         const struct video_scale_info *src, enum video_scale_type type, size_t max_slices) {
+    plane_info planes[MAX_AV_PLANES] = {};
+    auto plan = plan_scale_slices(src->height, dest->height, max_slices);
+    if (plan.empty() || !get_planes(src->format, src->width, src->height, planes) ||
+        !get_planes(dest->format, dest->width, dest->height, planes)) {
+        return false;
+    }
+
+    for (auto &rows : plan) {
+        ScaleSliceScaler slice = {};
+        slice.rows = rows;
+        slice.src = *src;
+        slice.dest = *dest;
+
+        struct video_scale_info band_src = *src;
+        struct video_scale_info band_dest = *dest;
+        band_src.height = rows.in_rows;
+        band_dest.height = rows.out_rows;
+        if (video_scaler_create(&slice.scaler, &band_dest, &band_src, type) != VIDEO_SCALER_SUCCESS) {
+            destroy_scale_slices(slices);
+            return false;
+        }
+
+        int count = get_planes(dest->format, dest->width, rows.out_rows, planes);
+        size_t size = 0;
+        for (int p = 0; p < count; p++) {
+            slice.scratch_linesize[p] = (planes[p].width_bytes + 31) & ~31u;
+            slice.scratch_offset[p] = size;
+            size += (size_t) slice.scratch_linesize[p] * planes[p].height;
+        }
+        slice.scratch.resize(size);
+        slices.push_back(std::move(slice));
+    }
+    return true;
+}
+
+void destroy_scale_slices(std::vector<ScaleSliceScaler> &slices) {
+    for (auto &slice : slices) {
+        video_scaler_destroy(slice.scaler);
+    }
+    slices.clear();
+}
+
+bool scale_slice(ScaleSliceScaler &slice, uint8_t *const output[], const uint32_t out_linesize[],
+                 const uint8_t *const input[], const uint32_t in_linesize[]) {
+    plane_info in_planes[MAX_AV_PLANES] = {};
+    plane_info out_planes[MAX_AV_PLANES] = {};
+    int in_count = get_planes(slice.src.format, slice.src.width, slice.src.height, in_planes);
+    int out_count = get_planes(slice.dest.format, slice.dest.width, slice.dest.height, out_planes);
+
+    const uint8_t *in_data[MAX_AV_PLANES] = {};
+    for (int p = 0; p < in_count; p++) {
+        uint32_t row = (uint32_t) ((uint64_t) slice.rows.in_row * in_planes[p].height / slice.src.height);
+        in_data[p] = input[p] + (size_t) in_linesize[p] * row;
+    }
+    uint8_t *scratch_data[MAX_AV_PLANES] = {};
+    for (int p = 0; p < out_count; p++) {
+        scratch_data[p] = slice.scratch.data() + slice.scratch_offset[p];
+    }
+    if (!video_scaler_scale(slice.scaler, scratch_data, slice.scratch_linesize, in_data, in_linesize)) {
+        return false;
+    }
+
+    // the margins only feed the filter at the band edges, copy the kept rows out
+    for (int p = 0; p < out_count; p++) {
+        uint32_t plane_height = out_planes[p].height;
+        uint32_t skip = (uint32_t) ((uint64_t) slice.rows.skip * plane_height / slice.dest.height);
+        uint32_t row = (uint32_t) ((uint64_t) slice.rows.out_row * plane_height / slice.dest.height);
+        uint32_t rows = (uint32_t) ((uint64_t) slice.rows.keep * plane_height / slice.dest.height);
+        for (uint32_t y = 0; y < rows; y++) {
+            memcpy(output[p] + (size_t) out_linesize[p] * (row + y),
+                   scratch_data[p] + (size_t) slice.scratch_linesize[p] * (skip + y),
+                   out_planes[p].width_bytes);
+        }
+    }
+    return true;
+}
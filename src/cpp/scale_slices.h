@@ -0,0 +1,48 @@
+#pragma once
+
+#include <media-io/video-scaler.h>
+#include <vector>
+
+struct plane_info {
+    uint32_t width_bytes;
+    uint32_t height;
+};
+
+// Returns the number of planes of the format, or 0 if the layout isn't known.
+int get_planes(enum video_format format, uint32_t width, uint32_t height, plane_info *planes);
+
+// Horizontal band of a sliced scale. The band scaler turns in_rows input rows from in_row into
+// out_rows rows, the first skip of them are margin and the next keep go to the output at out_row.
+struct ScaleSlice {
+    uint32_t in_row;
+    uint32_t in_rows;
+    uint32_t out_row;
+    uint32_t out_rows;
+    uint32_t skip;
+    uint32_t keep;
+};
+
+// Splits a scale into bands whose kept rows are exactly the rows of the full frame scale, or
+// returns no bands if the heights can't be split that way.
+std::vector<ScaleSlice> plan_scale_slices(uint32_t in_height, uint32_t out_height, size_t max_slices);
+
+struct ScaleSliceScaler {
+    ScaleSlice rows;
+    struct video_scale_info src;
+    struct video_scale_info dest;
+    video_scaler_t *scaler;
+    // band output including the margins
+    std::vector<uint8_t> scratch;
+    size_t scratch_offset[MAX_AV_PLANES];
+    uint32_t scratch_linesize[MAX_AV_PLANES];
+};
+
+// Returns false with no slices if the scale can't be sliced.
+bool create_scale_slices(std::vector<ScaleSliceScaler> &slices, const struct video_scale_info *dest,
+                         const struct video_scale_info *src, enum video_scale_type type, size_t max_slices);
+
+void destroy_scale_slices(std::vector<ScaleSliceScaler> &slices);
+
+// Bands write disjoint output rows, so they can be scaled in parallel.
+bool scale_slice(ScaleSliceScaler &slice, uint8_t *const output[], const uint32_t out_linesize[],
+                 const uint8_t *const input[], const uint32_t in_linesize[]);
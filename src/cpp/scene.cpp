@@ -1,5 +1,4 @@
 #include "scene.h"
-#include "dsk.h"
 #include <map>
 
 Scene::Scene(std::string &id, int index, Settings *settings) :
@@ -7,24 +6,29 @@ Scene::Scene(std::string &id, int index, Settings *settings) :
         index(index),
         settings(settings),
         obs_scene(createObsScene(id)),
-        obs_output_scene(nullptr) {
+        prepared(false) {
 }
 
 Scene::~Scene() {
-    if (obs_scene) {
-        obs_scene_release(obs_scene);
+    unprepare();
+    for (auto &source : sources) {
+        source.second->stop();
+        delete source.second;
     }
-    if (obs_output_scene) {
+    sources.clear();
+    if (obs_scene) {
         obs_scene_release(obs_scene);
     }
 }
 
-void Scene::addSource(std::string &sourceId, std::shared_ptr<SourceSettings> &settings) {
-    auto source = new Source(sourceId, id, obs_scene, settings);
-    sources[sourceId] = source;
+void Scene::addSource(Source *source) {
+    sources[source->getId()] = source;
+}
 
-    // Start the source as soon as it's added.
-    source->start();
+Source *Scene::takeSource(std::string &sourceId) {
+    Source *source = findSource(sourceId);
+    sources.erase(sourceId);
+    return source;
 }
 
 obs_scene_t *Scene::createObsScene(std::string &sceneId) {
@@ -35,63 +39,25 @@ obs_scene_t *Scene::createObsScene(std::string &sceneId) {
     return scene;
 }
 
-obs_scene_t *Scene::getObsOutputScene(std::map<std::string, Dsk *> &dsks) {
-    if (obs_output_scene) {
-        obs_scene_release(obs_output_scene);
-        obs_output_scene = nullptr;
+void Scene::prepare() {
+    if (prepared) {
+        return;
     }
+    // showing rather than active, active sources start their start-on-active playback
+    obs_source_inc_showing(obs_scene_get_source(obs_scene));
+    prepared = true;
+}
 
-    // create duplicate scene
-    obs_output_scene = obs_scene_duplicate(obs_scene, (id + "_output").c_str(), OBS_SCENE_DUP_REFS);
-
-    // add dsks
-    for (auto &dsk : dsks) {
-        // Add the source to the scene
-        obs_scene_item *obs_scene_item = obs_scene_add(obs_output_scene, dsk.second->getObsSource());
-        if (!obs_scene_item) {
-            throw std::runtime_error("Failed to add scene item.");
-        }
-
-        // set position
-        struct vec2 pos = {};
-        pos.x = (float) dsk.second->getLeft();
-        pos.y = (float) dsk.second->getTop();
-        obs_sceneitem_set_pos(obs_scene_item, &pos);
-
-        // set align
-        std::string position = dsk.second->getPosition();
-        uint32_t align = 0;
-        if (position == "top") {
-            align = OBS_ALIGN_TOP;
-        } else if (position == "top-right") {
-            align = OBS_ALIGN_TOP + OBS_ALIGN_RIGHT;
-        } else if (position == "right") {
-            align = OBS_ALIGN_RIGHT;
-        } else if (position == "bottom-right") {
-            align = OBS_ALIGN_BOTTOM + OBS_ALIGN_RIGHT;
-        } else if (position == "bottom") {
-            align = OBS_ALIGN_BOTTOM;
-        } else if (position == "bottom-left") {
-            align = OBS_ALIGN_BOTTOM + OBS_ALIGN_LEFT;
-        } else if (position == "left") {
-            align = OBS_ALIGN_LEFT;
-        } else if (position == "top-left") {
-            align = OBS_ALIGN_TOP + OBS_ALIGN_LEFT;
-        }
-        obs_sceneitem_set_bounds_alignment(obs_scene_item, align);
-
-        // set size
-        struct vec2 bounds = {};
-        bounds.x = (float) dsk.second->getWidth();
-        bounds.y = (float) dsk.second->getHeight();
-        obs_sceneitem_set_bounds_type(obs_scene_item, OBS_BOUNDS_SCALE_INNER);
-        obs_sceneitem_set_bounds(obs_scene_item, &bounds);
-
-        // set top most
-        obs_sceneitem_set_order(obs_scene_item, OBS_ORDER_MOVE_TOP);
+void Scene::unprepare() {
+    if (!prepared) {
+        return;
     }
+    obs_source_dec_showing(obs_scene_get_source(obs_scene));
+    prepared = false;
+}
 
-    return obs_output_scene;
+std::map<std::string, Source *> &Scene::getSources() {
+    return sources;
 }
 
 Source *Scene::findSource(std::string &sourceId) {
@@ -2,7 +2,6 @@
 
 #include "settings.h"
 #include "source.h"
-#include "dsk.h"
 #include <string>
 #include <map>
 #include <obs.h>
@@ -14,11 +13,27 @@ public:
 
     std::string getId() { return id; }
 
-    void addSource(std::string &sourceId, std::shared_ptr<SourceSettings> &settings);
+    // Takes ownership of the source, it's started by the caller.
+    void addSource(Source *source);
+
+    // Removes the source from the scene, the caller stops and frees it.
+    Source *takeSource(std::string &sourceId);
 
     Source *findSource(std::string &sourceId);
 
-    obs_scene_t *getObsOutputScene(std::map<std::string, Dsk*> &dsks);
+    std::map<std::string, Source *> &getSources();
+
+    // Dsks are rendered on their own output channel, the transition shows the scene itself.
+    obs_scene_t *getObsScene() { return obs_scene; }
+
+    // Shows the scene off-air for the sources that only render while showing. Media sources decode
+    // regardless since they are never closed when inactive, it doesn't start or speed up decoding.
+    void prepare();
+
+    // Releases the off-air showing, once the transition shows the scene or it's removed.
+    void unprepare();
+
+    bool isPrepared() const { return prepared; }
 
 private:
     static obs_scene_t *createObsScene(std::string &sceneId);
@@ -27,6 +42,6 @@ private:
     int index;
     Settings *settings;
     obs_scene_t *obs_scene;
-    obs_scene_t *obs_output_scene;
+    bool prepared;
     std::map<std::string, Source *> sources;
 };
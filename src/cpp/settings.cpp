@@ -16,19 +16,65 @@ AudioSettings::AudioSettings(const Napi::Object &audioSettings) {
 }
 
 OutputSettings::OutputSettings(const Napi::Object &outputSettings) {
+    id = getNapiStringOrDefault(outputSettings, "id", "");
     server = getNapiString(outputSettings, "server");
     key = getNapiString(outputSettings, "key");
-    hardwareEnable = getNapiBoolean(outputSettings, "hardwareEnable");
-    width = getNapiInt(outputSettings, "width");
-    height = getNapiInt(outputSettings, "height");
-    keyintSec = getNapiInt(outputSettings, "keyintSec");
-    rateControl = getNapiString(outputSettings, "rateControl");
-    preset = getNapiString(outputSettings, "preset");
-    profile = getNapiString(outputSettings, "profile");
-    tune = getNapiString(outputSettings, "tune");
+    audioOnly = getNapiBooleanOrDefault(outputSettings, "audioOnly", false);
+    passthrough = getNapiBooleanOrDefault(outputSettings, "passthrough", false);
     x264opts = getNapiStringOrDefault(outputSettings, "x264opts", "");
-    videoBitrateKbps = getNapiInt(outputSettings, "videoBitrateKbps");
+    videoFormat = getNapiStringOrDefault(outputSettings, "videoFormat", "");
+    scaleType = getNapiStringOrDefault(outputSettings, "scaleType", "fastBilinear");
+    if (audioOnly) {
+        // video encoder settings are not used without video
+        hardwareEnable = getNapiBooleanOrDefault(outputSettings, "hardwareEnable", false);
+        width = getNapiIntOrDefault(outputSettings, "width", 0);
+        height = getNapiIntOrDefault(outputSettings, "height", 0);
+        keyintSec = getNapiIntOrDefault(outputSettings, "keyintSec", 0);
+        rateControl = getNapiStringOrDefault(outputSettings, "rateControl", "");
+        preset = getNapiStringOrDefault(outputSettings, "preset", "");
+        profile = getNapiStringOrDefault(outputSettings, "profile", "");
+        tune = getNapiStringOrDefault(outputSettings, "tune", "");
+        videoBitrateKbps = getNapiIntOrDefault(outputSettings, "videoBitrateKbps", 0);
+    } else {
+        hardwareEnable = getNapiBoolean(outputSettings, "hardwareEnable");
+        width = getNapiInt(outputSettings, "width");
+        height = getNapiInt(outputSettings, "height");
+        keyintSec = getNapiInt(outputSettings, "keyintSec");
+        rateControl = getNapiString(outputSettings, "rateControl");
+        preset = getNapiString(outputSettings, "preset");
+        profile = getNapiString(outputSettings, "profile");
+        tune = getNapiString(outputSettings, "tune");
+        videoBitrateKbps = getNapiInt(outputSettings, "videoBitrateKbps");
+    }
     audioBitrateKbps = getNapiInt(outputSettings, "audioBitrateKbps");
+
+    // video bitrate follows the connection within the bounds, rtmp only
+    auto adaptive = outputSettings.Get("adaptiveBitrate");
+    adaptiveBitrate = !adaptive.IsUndefined() && !audioOnly;
+    if (adaptiveBitrate) {
+        auto adaptiveSettings = adaptive.As<Napi::Object>();
+        adaptiveMinKbps = getNapiIntOrDefault(adaptiveSettings, "minKbps", videoBitrateKbps / 4);
+        adaptiveMaxKbps = getNapiIntOrDefault(adaptiveSettings, "maxKbps", videoBitrateKbps);
+        adaptiveStepKbps = getNapiIntOrDefault(adaptiveSettings, "stepKbps", videoBitrateKbps / 10);
+        if (adaptiveMinKbps <= 0 || adaptiveMinKbps > adaptiveMaxKbps || adaptiveStepKbps <= 0) {
+            throw std::invalid_argument("Invalid adaptiveBitrate bounds");
+        }
+    } else {
+        adaptiveMinKbps = 0;
+        adaptiveMaxKbps = 0;
+        adaptiveStepKbps = 0;
+    }
+
+    // the delay doubles on every attempt
+    auto reconnect = outputSettings.Get("reconnect");
+    if (!reconnect.IsUndefined()) {
+        auto reconnectSettings = reconnect.As<Napi::Object>();
+        reconnectDelaySec = getNapiIntOrDefault(reconnectSettings, "retryDelaySec", 2);
+        reconnectMaxRetries = getNapiIntOrDefault(reconnectSettings, "maxRetries", 20);
+    } else {
+        reconnectDelaySec = 2;
+        reconnectMaxRetries = 20;
+    }
 }
 
 Settings::Settings(const Napi::Object &settings) :
@@ -69,8 +115,11 @@ Settings::Settings(const Napi::Object &settings) :
     for (auto output : outputs) {
         blog(LOG_INFO, "Output Settings");
         blog(LOG_INFO, "=====================");
+        blog(LOG_INFO, "id = %s", output->id.c_str());
         blog(LOG_INFO, "server = %s", output->server.c_str());
         blog(LOG_INFO, "key = %s", output->key.c_str());
+        blog(LOG_INFO, "audioOnly = %s", output->audioOnly ? "true" : "false");
+        blog(LOG_INFO, "passthrough = %s", output->passthrough ? "true" : "false");
         blog(LOG_INFO, "Video Encoder Settings");
         blog(LOG_INFO, "=====================");
         blog(LOG_INFO, "hardwareEnable = %s", output->hardwareEnable ? "true" : "false");
@@ -80,8 +129,14 @@ Settings::Settings(const Napi::Object &settings) :
         blog(LOG_INFO, "profile = %s", output->profile.c_str());
         blog(LOG_INFO, "tune = %s", output->tune.c_str());
         blog(LOG_INFO, "x264opts = %s", output->x264opts.c_str());
+        blog(LOG_INFO, "videoFormat = %s", output->videoFormat.c_str());
         blog(LOG_INFO, "Video bitrateKbps = %d", output->videoBitrateKbps);
         blog(LOG_INFO, "Audio bitrateKbps = %d", output->audioBitrateKbps);
+        blog(LOG_INFO, "reconnect = %ds delay, %d retries", output->reconnectDelaySec, output->reconnectMaxRetries);
+        if (output->adaptiveBitrate) {
+            blog(LOG_INFO, "Adaptive bitrateKbps = %d - %d, step %d",
+                 output->adaptiveMinKbps, output->adaptiveMaxKbps, output->adaptiveStepKbps);
+        }
     }
 }
 
@@ -94,7 +149,7 @@ Settings::~Settings() {
 }
 
 SourceSettings::SourceSettings(const Napi::Object &settings) :
-        output(nullptr) {
+        outputs() {
     type = getNapiString(settings, "type");
     isFile = getNapiBooleanOrDefault(settings, "isFile", false);
     url = getNapiString(settings, "url");
@@ -102,12 +157,21 @@ SourceSettings::SourceSettings(const Napi::Object &settings) :
     hardwareDecoder = getNapiBoolean(settings, "hardwareDecoder");
     enableBuffer = getNapiBooleanOrDefault(settings, "enableBuffer", true);
     bufferSize = getNapiIntOrDefault(settings, "bufferSize", 2);
-    if (!settings.Get("output").IsUndefined()) {
-        auto outputSettings = settings.Get("output").As<Napi::Object>();
-        output = new OutputSettings(outputSettings);
+    scaleSliceThreshold = getNapiIntOrDefault(settings, "scaleSliceThreshold", 2560 * 1440);
+    // output accepts a single output or an array of renditions
+    auto output = settings.Get("output");
+    if (output.IsArray()) {
+        auto outputObjects = output.As<Napi::Array>();
+        for (uint32_t i = 0; i < outputObjects.Length(); ++i) {
+            outputs.push_back(new OutputSettings(outputObjects.Get(i).As<Napi::Object>()));
+        }
+    } else if (!output.IsUndefined()) {
+        outputs.push_back(new OutputSettings(output.As<Napi::Object>()));
     }
 }
 
 SourceSettings::~SourceSettings() {
-    delete output;
+    for (auto output : outputs) {
+        delete output;
+    }
 }
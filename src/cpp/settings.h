@@ -22,8 +22,11 @@ class OutputSettings {
 
 public:
     explicit OutputSettings(const Napi::Object& outputSettings);
+    std::string id;
     std::string server;
     std::string key;
+    bool audioOnly;
+    bool passthrough;
     bool hardwareEnable;
     int width;
     int height;
@@ -33,8 +36,16 @@ public:
     std::string profile;
     std::string tune;
     std::string x264opts;
+    std::string videoFormat;
+    std::string scaleType;
     int videoBitrateKbps;
     int audioBitrateKbps;
+    bool adaptiveBitrate;
+    int adaptiveMinKbps;
+    int adaptiveMaxKbps;
+    int adaptiveStepKbps;
+    int reconnectDelaySec;
+    int reconnectMaxRetries;
 };
 
 class Settings {
@@ -58,5 +69,6 @@ public:
     bool hardwareDecoder;
     bool enableBuffer;
     int bufferSize;
-    OutputSettings *output;
+    int scaleSliceThreshold;
+    std::vector<OutputSettings*> outputs;
 };
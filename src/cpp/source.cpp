@@ -10,7 +10,8 @@ extern "C" {
 
 
 struct ScreenshotContext {
-    Source *source;
+    // a reference of our own, the source may be removed before the graphics task runs
+    obs_source_t *source;
     std::function<void(uint8_t*, int)> callback;
 };
 
@@ -59,9 +60,11 @@ void Source::volmeter_callback(void *param, const float *magnitude, const float
 
 void Source::screenshot_callback(void *param) {
     auto p = (ScreenshotContext *)param;
-    int width = (int) obs_source_get_width(p->source->obs_source);
-    int height = (int) obs_source_get_height(p->source->obs_source);
+    int width = (int) obs_source_get_width(p->source);
+    int height = (int) obs_source_get_height(p->source);
     if (width == 0 || height == 0) {
+        obs_source_release(p->source);
+        delete p;
         return;
     }
 
@@ -76,7 +79,7 @@ void Source::screenshot_callback(void *param) {
             gs_ortho(0.0f, (float) width, 0.0f, (float) height, -100.0f, 100.0f);
             gs_blend_state_push();
             gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
-            obs_source_video_render(p->source->obs_source);
+            obs_source_video_render(p->source);
             gs_blend_state_pop();
             gs_texrender_end(texrender);
             gs_stage_texture(stagesurf, gs_texrender_get_texture(texrender));
@@ -93,6 +96,8 @@ void Source::screenshot_callback(void *param) {
     gs_texrender_destroy(texrender);
     gs_stagesurface_destroy(stagesurf);
     obs_leave_graphics();
+    obs_source_release(p->source);
+    delete p;
 }
 
 void Source::source_activate_callback(void *param, calldata_t *data) {
@@ -112,7 +117,8 @@ void Source::source_deactivate_callback(void *param, calldata_t *data) {
 }
 
 Source::Source(std::string &id, std::string &sceneId, obs_scene_t *obs_scene,
-               std::shared_ptr<SourceSettings> &settings) :
+               std::shared_ptr<SourceSettings> &settings,
+               std::function<void(const std::string &)> relayFallback) :
         id(id),
         sceneId(sceneId),
         obs_scene(obs_scene),
@@ -123,7 +129,9 @@ Source::Source(std::string &id, std::string &sceneId, obs_scene_t *obs_scene,
         obs_scene_item(nullptr),
         obs_volmeter(nullptr),
         obs_fader(nullptr),
-        transcoder(nullptr) {
+        transcoder(nullptr),
+        relay_fallback(std::move(relayFallback)),
+        relays() {
 }
 
 void Source::start() {
@@ -183,10 +191,28 @@ void Source::start() {
     }
     obs_fader_attach_source(obs_fader, obs_source);
 
-    // source output
-    if (settings->output) {
+    // output ids identify the output in events and stats, the default is unique in the studio
+    for (size_t i = 0; i < settings->outputs.size(); i++) {
+        if (settings->outputs[i]->id.empty()) {
+            settings->outputs[i]->id = sceneId + "/" + id + "/output" + std::to_string(i);
+        }
+    }
+
+    // source output, passthrough outputs are relayed as is when the input codecs match,
+    // the relay falls back to transcoding itself otherwise
+    std::vector<OutputSettings *> transcoded;
+    for (auto output : settings->outputs) {
+        if (output->passthrough && type == MediaSource) {
+            auto relay = new SourceRelay(this, url, output, settings->isFile, relay_fallback);
+            relay->start();
+            relays.push_back(relay);
+            continue;
+        }
+        transcoded.push_back(output);
+    }
+    if (!transcoded.empty()) {
         transcoder = new SourceTranscoder();
-        transcoder->start(this);
+        transcoder->start(this, transcoded);
     }
 
     // pause to beginning if it's start at active
@@ -210,14 +236,22 @@ void Source::stop() {
         transcoder = nullptr;
     }
 
+    for (auto relay : relays) {
+        relay->stop();
+        delete relay;
+    }
+    relays.clear();
+
     if (obs_volmeter) {
         obs_volmeter_remove_callback(obs_volmeter, volmeter_callback, this);
         obs_volmeter_detach_source(obs_volmeter);
         obs_volmeter_destroy(obs_volmeter);
+        obs_volmeter = nullptr;
     }
     if (obs_fader) {
         obs_fader_detach_source(obs_fader);
         obs_fader_destroy(obs_fader);
+        obs_fader = nullptr;
     }
 
     // obs_sceneitem_remove will call obs_sceneitem_release internally,
@@ -234,6 +268,14 @@ void Source::restart() {
     start();
 }
 
+void Source::fallbackRelay(const std::string &outputId) {
+    for (auto relay : relays) {
+        if (relay->getSettings()->id == outputId) {
+            relay->startFallback();
+        }
+    }
+}
+
 std::string Source::getId() {
     return id;
 }
@@ -264,14 +306,22 @@ float Source::getVolume() {
     return obs_fader ? obs_fader_get_db(obs_fader) : 0;
 }
 
-void Source::screenshot(std::function<void(uint8_t*, int)> callback) {
+void Source::screenshot(obs_source_t *obs_source, std::function<void(uint8_t*, int)> callback) {
     auto p = new ScreenshotContext {
-      .source = this,
+      .source = obs_source,
       .callback = std::move(callback),
     };
     obs_queue_task(OBS_TASK_GRAPHICS, screenshot_callback, p, false);
 }
 
+SourceTranscoder *Source::getTranscoder() {
+    return transcoder;
+}
+
+std::vector<SourceRelay *> Source::getRelays() {
+    return relays;
+}
+
 void Source::setAudioLock(bool audioLock) {
     if (obs_source) {
         obs_source_set_audio_lock(obs_source, audioLock);
@@ -2,7 +2,9 @@
 
 #include "settings.h"
 #include "source_transcoder.h"
+#include "source_relay.h"
 #include <obs.h>
+#include <functional>
 #include <string>
 
 enum SourceType {
@@ -19,10 +21,13 @@ public:
 
     static std::string getSourceTypeString(SourceType sourceType);
 
+    // relayFallback is called on a relay thread with the output id when a passthrough output has
+    // to be transcoded, the owner calls fallbackRelay for it on the thread that starts and stops the source.
     Source(std::string &id,
            std::string &sceneId,
            obs_scene_t *obs_scene,
-           std::shared_ptr<SourceSettings> &settings
+           std::shared_ptr<SourceSettings> &settings,
+           std::function<void(const std::string &)> relayFallback
     );
 
     void start();
@@ -31,6 +36,9 @@ public:
 
     void restart();
 
+    // Starts the transcoder of a passthrough output whose input didn't match, see SourceRelay.
+    void fallbackRelay(const std::string &outputId);
+
     std::string getId();
 
     std::string getSceneId();
@@ -53,7 +61,15 @@ public:
 
     bool getAudioMonitor();
 
-    void screenshot(std::function<void(uint8_t*, int)> callback);
+    // Takes over a reference of the obs source, renders it to png on the graphics thread,
+    // the data passed to the callback is only valid during the call.
+    static void screenshot(obs_source_t *obs_source, std::function<void(uint8_t*, int)> callback);
+
+    obs_source_t *getObsSource() { return obs_source; }
+
+    SourceTranscoder *getTranscoder();
+
+    std::vector<SourceRelay *> getRelays();
 
 private:
     static void volmeter_callback(
@@ -82,4 +98,6 @@ private:
     obs_fader_t *obs_fader;
 
     SourceTranscoder *transcoder;
+    std::function<void(const std::string &)> relay_fallback;
+    std::vector<SourceRelay *> relays;
 };
@@ -0,0 +1,404 @@
+#include "source_relay.h"
+#include "source.h"
+#include "source_transcoder.h"
+#include <obs.h>
+#include <util/platform.h>
+#include <algorithm>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+
+#define RELAY_OPEN_TIMEOUT 10000000000
+#define RELAY_RETRY_DELAY_MS 1000
+#define RELAY_BITRATE_TOLERANCE 1.2
+#define RELAY_MAX_PACE_AHEAD 1000000000
+#define RELAY_PACE_SLEEP_MS 10
+
+SourceRelay::SourceRelay(Source *source, const std::string &url, OutputSettings *settings, bool isFile,
+                         std::function<void(const std::string &)> onFallback) :
+        source(source),
+        id(source->getId()),
+        url(url),
+        settings(settings),
+        is_file(isFile),
+        on_fallback(std::move(onFallback)),
+        input(nullptr),
+        output(nullptr),
+        stream_map(),
+        video_index(-1),
+        loop_offset_us(0),
+        loop_end_us(0),
+        thread(),
+        stopping(false),
+        deadline(0),
+        pace_start_dts(0),
+        pace_start_time(0),
+        needs_fallback(false),
+        fallback_mutex(),
+        fallback(nullptr),
+        connected(false),
+        packets(0),
+        frames(0),
+        bytes(0),
+        reconnects(0),
+        stats_mutex(),
+        stats_bytes(0),
+        stats_time(0),
+        stats_bitrate(0) {
+}
+
+SourceRelay::~SourceRelay() {
+    stop();
+    close_input();
+}
+
+bool SourceRelay::probe() {
+    if (!open_input()) {
+        return false;
+    }
+
+    bool has_video = false;
+    bool has_audio = false;
+    for (unsigned int i = 0; i < input->nb_streams; i++) {
+        AVCodecParameters *par = input->streams[i]->codecpar;
+        if (par->codec_type == AVMEDIA_TYPE_VIDEO && !has_video) {
+            if (par->codec_id != AV_CODEC_ID_H264) {
+                blog(LOG_INFO, "[%s] relay: video codec %s is not h264", id.c_str(), avcodec_get_name(par->codec_id));
+                return false;
+            }
+            if (par->width != settings->width || par->height != settings->height) {
+                blog(LOG_INFO, "[%s] relay: video size %dx%d doesn't match output %dx%d",
+                     id.c_str(), par->width, par->height, settings->width, settings->height);
+                return false;
+            }
+            // bitrate is only known for some inputs, check it when it is
+            if (par->bit_rate > settings->videoBitrateKbps * 1000 * RELAY_BITRATE_TOLERANCE) {
+                blog(LOG_INFO, "[%s] relay: video bitrate %lld exceeds output %dkbps",
+                     id.c_str(), (long long) par->bit_rate, settings->videoBitrateKbps);
+                return false;
+            }
+            has_video = true;
+        } else if (par->codec_type == AVMEDIA_TYPE_AUDIO && !has_audio) {
+            if (par->codec_id != AV_CODEC_ID_AAC) {
+                blog(LOG_INFO, "[%s] relay: audio codec %s is not aac", id.c_str(), avcodec_get_name(par->codec_id));
+                return false;
+            }
+            has_audio = true;
+        }
+    }
+
+    if (!has_audio || (!has_video && !settings->audioOnly)) {
+        blog(LOG_INFO, "[%s] relay: input is missing %s", id.c_str(), has_audio ? "video" : "audio");
+        return false;
+    }
+    return true;
+}
+
+void SourceRelay::start() {
+    stopping = false;
+    thread = std::thread(&SourceRelay::run, this);
+}
+
+void SourceRelay::stop() {
+    stopping = true;
+    if (thread.joinable()) {
+        thread.join();
+    }
+
+    std::unique_lock<std::mutex> lock(fallback_mutex);
+    if (fallback) {
+        fallback->stop();
+        delete fallback;
+        fallback = nullptr;
+    }
+}
+
+SourceRelayStats SourceRelay::getStats() {
+    SourceRelayStats stats = {};
+    stats.packets = packets;
+    stats.bytes = bytes;
+    stats.reconnects = reconnects;
+    std::unique_lock<std::mutex> lock(fallback_mutex);
+    stats.transcoded = fallback != nullptr;
+    return stats;
+}
+
+OutputStats SourceRelay::getOutputStats() {
+    {
+        std::unique_lock<std::mutex> lock(fallback_mutex);
+        if (fallback && !fallback->getOutputs().empty()) {
+            return fallback->getOutputs()[0]->getStats();
+        }
+    }
+
+    OutputStats stats = {};
+    stats.id = settings->id;
+    stats.active = connected;
+    stats.totalBytes = bytes;
+    stats.totalFrames = (int) frames;
+
+    // same windowing as Output::getStats
+    std::unique_lock<std::mutex> lock(stats_mutex);
+    uint64_t now = os_gettime_ns();
+    if (!stats_time) {
+        stats_bytes = stats.totalBytes;
+        stats_time = now;
+    } else if (now - stats_time >= OUTPUT_STATS_WINDOW) {
+        stats_bitrate = (int) ((stats.totalBytes - stats_bytes) * 8000000 / (now - stats_time));
+        stats_bytes = stats.totalBytes;
+        stats_time = now;
+    }
+    stats.bitrateKbps = stats_bitrate;
+    return stats;
+}
+
+OutputSettings *SourceRelay::getSettings() {
+    return settings;
+}
+
+int SourceRelay::interrupt_callback(void *param) {
+    auto relay = (SourceRelay *) param;
+    return relay->stopping || (relay->deadline && os_gettime_ns() > relay->deadline);
+}
+
+bool SourceRelay::open_input() {
+    close_input();
+    input = avformat_alloc_context();
+    input->interrupt_callback.callback = interrupt_callback;
+    input->interrupt_callback.opaque = this;
+
+    deadline = os_gettime_ns() + RELAY_OPEN_TIMEOUT;
+    int ret = avformat_open_input(&input, url.c_str(), nullptr, nullptr);
+    if (ret >= 0) {
+        ret = avformat_find_stream_info(input, nullptr);
+    }
+    deadline = 0;
+
+    if (ret < 0) {
+        blog(LOG_ERROR, "[%s] relay: failed to open input %s: %d", id.c_str(), url.c_str(), ret);
+        close_input();
+        return false;
+    }
+    return true;
+}
+
+bool SourceRelay::open_output() {
+    close_output();
+    bool is_rtmp = settings->server.rfind("rtmp", 0) == 0;
+    std::string output_url = getOutputUrl();
+    if (avformat_alloc_output_context2(&output, nullptr, is_rtmp ? "flv" : "mpegts", output_url.c_str()) < 0) {
+        blog(LOG_ERROR, "[%s] relay: failed to create output context", id.c_str());
+        return false;
+    }
+
+    // first video stream and first audio stream, audio only outputs drop video
+    stream_map.assign(input->nb_streams, -1);
+    video_index = -1;
+    bool has_video = false;
+    bool has_audio = false;
+    for (unsigned int i = 0; i < input->nb_streams; i++) {
+        AVCodecParameters *par = input->streams[i]->codecpar;
+        bool video = par->codec_type == AVMEDIA_TYPE_VIDEO && !has_video && !settings->audioOnly;
+        bool audio = par->codec_type == AVMEDIA_TYPE_AUDIO && !has_audio;
+        if (!video && !audio) {
+            continue;
+        }
+        AVStream *stream = avformat_new_stream(output, nullptr);
+        avcodec_parameters_copy(stream->codecpar, par);
+        stream->codecpar->codec_tag = 0;
+        stream->time_base = input->streams[i]->time_base;
+        stream_map[i] = stream->index;
+        if (video) {
+            video_index = stream->index;
+        }
+        has_video |= video;
+        has_audio |= audio;
+    }
+
+    output->interrupt_callback.callback = interrupt_callback;
+    output->interrupt_callback.opaque = this;
+    int ret = avio_open2(&output->pb, output_url.c_str(), AVIO_FLAG_WRITE, &output->interrupt_callback, nullptr);
+    if (ret >= 0) {
+        ret = avformat_write_header(output, nullptr);
+    }
+    if (ret < 0) {
+        blog(LOG_ERROR, "[%s] relay: failed to open output %s: %d", id.c_str(), settings->server.c_str(), ret);
+        close_output();
+        return false;
+    }
+    return true;
+}
+
+void SourceRelay::close_input() {
+    if (input) {
+        avformat_close_input(&input);
+    }
+}
+
+void SourceRelay::close_output() {
+    if (output) {
+        if (output->pb) {
+            avio_closep(&output->pb);
+        }
+        avformat_free_context(output);
+        output = nullptr;
+    }
+}
+
+void SourceRelay::run() {
+    // opening the input may take up to RELAY_OPEN_TIMEOUT, so it's probed here and not in Source::start
+    if (!probe()) {
+        close_input();
+        // the transcoder is started and stopped with the source, not from this thread
+        if (!stopping) {
+            blog(LOG_INFO, "[%s] passthrough is not possible, fall back to transcoding", id.c_str());
+            needs_fallback = true;
+            on_fallback(settings->id);
+        }
+        return;
+    }
+    relay();
+}
+
+void SourceRelay::relay() {
+    AVPacket *packet = av_packet_alloc();
+    connected = input && open_output();
+    pace_start_time = 0;
+    loop_offset_us = 0;
+    loop_end_us = 0;
+    while (!stopping) {
+        if (!connected) {
+            os_sleep_ms(RELAY_RETRY_DELAY_MS);
+            if (stopping) {
+                break;
+            }
+            reconnects++;
+            blog(LOG_INFO, "[%s] relay: reconnecting", id.c_str());
+            connected = open_input() && open_output();
+            pace_start_time = 0;
+            loop_offset_us = 0;
+            loop_end_us = 0;
+            continue;
+        }
+
+        if (av_read_frame(input, packet) < 0) {
+            // the output stays connected through the loop of a file
+            if (is_file && loop_input()) {
+                continue;
+            }
+            blog(LOG_INFO, "[%s] relay: input ended", id.c_str());
+            av_write_trailer(output);
+            close_output();
+            close_input();
+            connected = false;
+            continue;
+        }
+
+        int index = packet->stream_index < (int) stream_map.size() ? stream_map[packet->stream_index] : -1;
+        if (index < 0) {
+            av_packet_unref(packet);
+            continue;
+        }
+
+        AVRational time_base = input->streams[packet->stream_index]->time_base;
+        if (loop_offset_us) {
+            int64_t offset = av_rescale_q(loop_offset_us, AVRational{1, AV_TIME_BASE}, time_base);
+            if (packet->pts != AV_NOPTS_VALUE) {
+                packet->pts += offset;
+            }
+            if (packet->dts != AV_NOPTS_VALUE) {
+                packet->dts += offset;
+            }
+        }
+        if (packet->dts != AV_NOPTS_VALUE) {
+            int64_t dts_us = av_rescale_q(packet->dts, time_base, AVRational{1, AV_TIME_BASE});
+            int64_t duration_us = av_rescale_q(packet->duration, time_base, AVRational{1, AV_TIME_BASE});
+            loop_end_us = std::max(loop_end_us, dts_us + duration_us);
+            if (is_file) {
+                pace(dts_us);
+            }
+        }
+
+        av_packet_rescale_ts(packet, time_base, output->streams[index]->time_base);
+        packet->stream_index = index;
+        packet->pos = -1;
+        int size = packet->size;
+        if (av_interleaved_write_frame(output, packet) < 0) {
+            blog(LOG_ERROR, "[%s] relay: failed to write packet", id.c_str());
+            close_output();
+            close_input();
+            connected = false;
+        } else {
+            packets++;
+            bytes += size;
+            if (index == video_index) {
+                frames++;
+            }
+        }
+        av_packet_unref(packet);
+    }
+
+    if (output) {
+        av_write_trailer(output);
+    }
+    close_output();
+    connected = false;
+    av_packet_free(&packet);
+}
+
+bool SourceRelay::loop_input() {
+    int64_t start_us = input->start_time == AV_NOPTS_VALUE ? 0 : input->start_time;
+    if (av_seek_frame(input, -1, start_us, AVSEEK_FLAG_BACKWARD) < 0) {
+        blog(LOG_WARNING, "[%s] relay: failed to seek to the start of the input", id.c_str());
+        return false;
+    }
+    loop_offset_us = loop_end_us - start_us;
+    return true;
+}
+
+void SourceRelay::startFallback() {
+    if (!needs_fallback || stopping) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(fallback_mutex);
+    if (fallback) {
+        return;
+    }
+    fallback = new SourceTranscoder();
+    try {
+        fallback->start(source, {settings});
+    } catch (const std::exception &e) {
+        blog(LOG_ERROR, "[%s] relay: failed to start the fallback transcoder: %s", id.c_str(), e.what());
+    }
+}
+
+void SourceRelay::pace(int64_t dts_us) {
+    uint64_t now = os_gettime_ns();
+    int64_t offset = (dts_us - pace_start_dts) * 1000;
+
+    // the first packet or a timestamp jump restart the clock, a loop of the file carries on
+    if (!pace_start_time || offset < 0 || (uint64_t) offset > now - pace_start_time + RELAY_MAX_PACE_AHEAD) {
+        pace_start_dts = dts_us;
+        pace_start_time = now;
+        return;
+    }
+
+    uint64_t due = pace_start_time + offset;
+    while (!stopping && now < due) {
+        os_sleep_ms((uint32_t) std::min<uint64_t>((due - now) / 1000000 + 1, RELAY_PACE_SLEEP_MS));
+        now = os_gettime_ns();
+    }
+}
+
+std::string SourceRelay::getOutputUrl() {
+    if (settings->server.rfind("rtmp", 0) != 0 || settings->key.empty()) {
+        return settings->server;
+    }
+    std::string server = settings->server;
+    if (server.back() == '/') {
+        server.pop_back();
+    }
+    return server + "/" + settings->key;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "settings.h"
+#include "output.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct AVFormatContext;
+class Source;
+class SourceTranscoder;
+
+struct SourceRelayStats {
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t reconnects;
+    bool transcoded;
+};
+
+// Forwards the compressed H.264/AAC packets of a source url to an output without
+// decoding, it's used instead of a transcoded output when the codecs already match.
+// The relay opens the url itself, next to the ffmpeg_source that decodes it, so the
+// upstream is pulled twice while a passthrough output is running.
+class SourceRelay {
+
+public:
+    // Files are paced by their timestamps, they would be read as fast as the disk allows
+    // otherwise, and looped like the ffmpeg_source does. onFallback is called on the relay
+    // thread with the output id when the input doesn't match the output settings.
+    SourceRelay(Source *source, const std::string &url, OutputSettings *settings, bool isFile,
+                std::function<void(const std::string &)> onFallback);
+
+    ~SourceRelay();
+
+    // Probes the input on the relay thread.
+    void start();
+
+    void stop();
+
+    // Starts a transcoder of its own for the output after onFallback, on the thread that
+    // starts and stops the source.
+    void startFallback();
+
+    SourceRelayStats getStats();
+
+    // Stats of the relayed output, or of the fallback transcoder's output.
+    OutputStats getOutputStats();
+
+    OutputSettings *getSettings();
+
+private:
+    static int interrupt_callback(void *param);
+
+    // Opens the input and checks its streams against the output settings,
+    // returns false if the output has to be transcoded instead.
+    bool probe();
+
+    bool open_input();
+
+    bool open_output();
+
+    void close_input();
+
+    void close_output();
+
+    void run();
+
+    void relay();
+
+    // seeks a file back to its start, the timestamps carry on from its end
+    bool loop_input();
+
+    // sleeps until the packet's dts is due on the wall clock, like ffmpeg -re
+    void pace(int64_t dts_us);
+
+    std::string getOutputUrl();
+
+    Source *source;
+    std::string id;
+    std::string url;
+    OutputSettings *settings;
+    bool is_file;
+    std::function<void(const std::string &)> on_fallback;
+    AVFormatContext *input;
+    AVFormatContext *output;
+    std::vector<int> stream_map;
+    int video_index;
+    int64_t loop_offset_us;
+    int64_t loop_end_us;
+    std::thread thread;
+    std::atomic<bool> stopping;
+    uint64_t deadline;
+    int64_t pace_start_dts;
+    uint64_t pace_start_time;
+    std::atomic<bool> needs_fallback;
+    std::mutex fallback_mutex;
+    SourceTranscoder *fallback;
+    std::atomic<bool> connected;
+    std::atomic<uint64_t> packets;
+    std::atomic<uint64_t> frames;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> reconnects;
+
+    std::mutex stats_mutex;
+    uint64_t stats_bytes;
+    uint64_t stats_time;
+    int stats_bitrate;
+};
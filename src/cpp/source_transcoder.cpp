@@ -1,13 +1,26 @@
 #include "source_transcoder.h"
 #include "source.h"
+#include "transcoder_scheduler.h"
+#include "scale_slices.h"
 #include <media-io/video-frame.h>
 #include <util/platform.h>
+#include <algorithm>
+#include <cmath>
+#include <thread>
 
 #define VIDEO_RESET_THRESHOLD 1000000000
 #define VIDEO_SMOOTH_THRESHOLD 2000000
 #define AUDIO_RESET_THRESHOLD 2000000000
 #define AUDIO_SMOOTH_THRESHOLD 70000000
 #define AUDIO_MAX_TIMESTAMP_BUFFER 1000000000
+#define AUDIO_DRIFT_DEADBAND 1000000
+#define AUDIO_DRIFT_WINDOW 1000000000.0
+#define AUDIO_MAX_DRIFT 0.005
+#define AUDIO_DRIFT_SLEW 0.0001
+#define AUDIO_RESAMPLE_EPSILON 0.000001
+#define SCALER_CACHE_SIZE 4
+#define SCALER_EVICT_THRESHOLD 10000000000
+#define SCALER_MAX_SLICES 4
 
 struct ts_info {
     uint64_t start;
@@ -18,47 +31,79 @@ static inline uint64_t uint64_diff(uint64_t ts1, uint64_t ts2) {
     return (ts1 < ts2) ? (ts2 - ts1) : (ts1 - ts2);
 }
 
+static bool copy_planes(uint8_t *const dst[], const uint32_t dst_linesize[], const uint8_t *const src[],
+                        const uint32_t src_linesize[], enum video_format format, uint32_t width, uint32_t height) {
+    plane_info planes[MAX_AV_PLANES] = {};
+    int count = get_planes(format, width, height, planes);
+    if (!count) {
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        if (dst_linesize[i] == src_linesize[i]) {
+            memcpy(dst[i], src[i], (size_t) src_linesize[i] * planes[i].height);
+            continue;
+        }
+        for (uint32_t y = 0; y < planes[i].height; y++) {
+            memcpy(dst[i] + (size_t) dst_linesize[i] * y,
+                   src[i] + (size_t) src_linesize[i] * y,
+                   planes[i].width_bytes);
+        }
+    }
+    return true;
+}
+
+static bool copy_frame_planes(struct video_frame *dst, const obs_source_frame *src) {
+    return copy_planes(dst->data, dst->linesize, src->data, src->linesize, src->format, src->width, src->height);
+}
+
 SourceTranscoder::SourceTranscoder() :
         source(nullptr),
-        output(nullptr),
-        video(nullptr),
+        outputs(),
+        videos(),
+        audio_only(false),
         frame_buf(),
+        frame_pool(),
         frame_buf_mutex(),
-        video_scaler(nullptr),
+        frame_buf_contention(0),
+        captured_frames(0),
+        capture_ns(0),
+        ticks(0),
+        select_ns(0),
+        last_tick_frame(),
+        repeated_frames(0),
+        scalers_created(0),
+        scalers_evicted(0),
         last_video_time(0),
         last_frame_ts(0),
-        video_stop(false),
-        video_thread(),
         audio(nullptr),
+        audio_ring(),
         audio_buf(),
-        audio_buf_mutex(),
         audio_timestamp_buf(),
         audio_time(0),
         last_audio_time(0),
-        timing_adjust(0),
-        timing_mutex() {
+        audio_overflows(0),
+        audio_underruns(0),
+        resample_buf(),
+        resample_last(),
+        resample_pos(0.0),
+        resample_ratio(1.0),
+        drift_error(0.0),
+        drift_ppm(0),
+        drift_corrections(0),
+        timing_adjust(0) {
 }
 
-void SourceTranscoder::start(Source *s) {
+void SourceTranscoder::start(Source *s, const std::vector<OutputSettings *> &outputSettings) {
     source = s;
-    output = new Output(source->settings->output);
-
-    // video output
-    obs_video_info ovi = {};
-    obs_get_video_info(&ovi);
 
-    video_output_info voi = {};
-    std::string videoOutputName = std::string("source_video_output_") + source->id;
-    voi.name = videoOutputName.c_str();
-    voi.format = VIDEO_FORMAT_BGRA;
-    voi.width = source->settings->output->width;
-    voi.height = source->settings->output->height;
-    voi.fps_num = ovi.fps_num;
-    voi.fps_den = ovi.fps_den;
-    voi.cache_size = 16;
-    video_output_open(&video, &voi);
-
-    video_thread = std::thread(&SourceTranscoder::video_output_callback, this);
+    // video outputs, renditions with the same size, format and scale type share one
+    std::vector<TranscoderVideo *> rendition_videos;
+    for (auto settings : outputSettings) {
+        auto output = new Output(settings);
+        outputs.push_back(output);
+        rendition_videos.push_back(settings->audioOnly ? nullptr : get_or_create_video(output, settings));
+    }
+    audio_only = videos.empty();
 
     // audio output
     for (auto &buf : audio_buf) {
@@ -77,37 +122,57 @@ void SourceTranscoder::start(Source *s) {
     aoi.input_callback = audio_output_callback;
     aoi.input_param = this;
 
+    audio_ring.open(get_audio_channels(oai.speakers), oai.samples_per_sec);
     obs_source_add_audio_capture_callback(source->obs_source, audio_capture_callback, this);
 
     audio_output_open(&audio, &aoi);
 
-    output->start(video, audio);
+    for (size_t i = 0; i < outputs.size(); i++) {
+        outputs[i]->start(rendition_videos[i] ? rendition_videos[i]->video : nullptr, audio);
+    }
+
+    // audio only, no frame capture and no pacing, timing comes from the audio timestamps
+    if (audio_only) {
+        return;
+    }
 
     signal_handler_t *handler = obs_source_get_signal_handler(source->obs_source);
     signal_handler_connect(handler, "media_get_frame", source_media_get_frame_callback, this);
+
+    obs_video_info ovi = {};
+    obs_get_video_info(&ovi);
+    TranscoderScheduler::getInstance().add(this, ovi.fps_num, ovi.fps_den);
 }
 
 void SourceTranscoder::stop() {
-    signal_handler_t *handler = obs_source_get_signal_handler(source->obs_source);
-    signal_handler_disconnect(handler, "media_get_frame", source_media_get_frame_callback, this);
-
-    output->stop();
-    delete output;
-    output = nullptr;
+    if (!audio_only) {
+        signal_handler_t *handler = obs_source_get_signal_handler(source->obs_source);
+        signal_handler_disconnect(handler, "media_get_frame", source_media_get_frame_callback, this);
+    }
 
-    video_stop = true;
-    video_thread.join();
-    video_stop = false;
+    for (auto output : outputs) {
+        output->stop();
+        delete output;
+    }
+    outputs.clear();
 
-    video_output_stop(video);
-    video_output_close(video);
+    if (!audio_only) {
+        TranscoderScheduler::getInstance().remove(this);
+    }
 
-    if (video_scaler) {
-        video_scaler_destroy(video_scaler);
-        video_scaler = nullptr;
+    for (auto v : videos) {
+        video_output_stop(v->video);
+        video_output_close(v->video);
+        for (auto &entry : v->scalers) {
+            destroy_video_scaler(&entry);
+        }
+        delete v;
     }
+    videos.clear();
 
+    last_tick_frame = nullptr;
     reset_video();
+    frame_pool.clear();
 
     last_video_time = 0;
     last_frame_ts = 0;
@@ -118,25 +183,65 @@ void SourceTranscoder::stop() {
     audio_output_close(audio);
 
     reset_audio();
+    audio_ring.close();
 
     audio_time = 0;
     last_audio_time = 0;
     timing_adjust = 0;
 }
 
+std::vector<Output *> &SourceTranscoder::getOutputs() {
+    return outputs;
+}
+
+TranscoderStats SourceTranscoder::getStats() {
+    TranscoderStats stats = {};
+    stats.framePoolHits = frame_pool.getHits();
+    stats.framePoolMisses = frame_pool.getMisses();
+    stats.framePoolSize = frame_pool.getSize();
+    stats.frameLockContention = frame_buf_contention;
+    stats.avgCaptureNs = captured_frames ? capture_ns / captured_frames : 0;
+    stats.avgSelectNs = ticks ? select_ns / ticks : 0;
+    stats.repeatedFrames = repeated_frames;
+    stats.scalersCreated = scalers_created;
+    stats.scalersEvicted = scalers_evicted;
+    stats.audioOverflows = audio_overflows;
+    stats.audioUnderruns = audio_underruns;
+    stats.driftPpm = drift_ppm;
+    stats.driftCorrections = drift_corrections;
+    for (auto v : videos) {
+        const struct video_output_info *voi = video_output_get_info(v->video);
+        TranscoderVideoStats video_stats = {};
+        video_stats.width = voi->width;
+        video_stats.height = voi->height;
+        video_stats.format = get_video_format_name(voi->format);
+        video_stats.scaleType = v->scale_type_name;
+        video_stats.renditions = v->renditions;
+        video_stats.frames = v->frames;
+        video_stats.passthroughFrames = v->passthrough_frames;
+        video_stats.slicedFrames = v->sliced_frames;
+        video_stats.avgConvertNs = v->frames ? v->convert_ns / v->frames : 0;
+        stats.videos.push_back(video_stats);
+    }
+    return stats;
+}
+
 void SourceTranscoder::source_media_get_frame_callback(void *param, calldata_t *data) {
     auto transcoder = (SourceTranscoder *) param;
     auto *frame = (obs_source_frame *) calldata_ptr(data, "frame");
 
-    // create video scaler after first frame is received
-    if (!transcoder->video_scaler) {
-        transcoder->create_video_scaler(frame);
-    }
-
-    obs_source_frame *new_frame = obs_source_frame_create(frame->format, frame->width, frame->height);
+    uint64_t capture_start = os_gettime_ns();
+    obs_source_frame *new_frame = transcoder->frame_pool.acquire(frame->format, frame->width, frame->height);
     obs_source_frame_copy(new_frame, frame);
+    transcoder->capture_ns += os_gettime_ns() - capture_start;
+    transcoder->captured_frames++;
+
+    // the frame goes back to the pool once the last holder drops it
+    std::shared_ptr<obs_source_frame> handle(new_frame, [transcoder](obs_source_frame *f) {
+        transcoder->frame_pool.release(f);
+    });
 
-    transcoder->frame_buf_mutex.lock();
+    auto lock = transcoder->lock_frame_buf();
 
     // clear frame buffer, only keep latest frame
     if (transcoder->last_frame_ts &&
@@ -146,52 +251,79 @@ void SourceTranscoder::source_media_get_frame_callback(void *param, calldata_t *
         transcoder->reset_video();
     }
 
-    circlebuf_push_back(&transcoder->frame_buf, &new_frame, sizeof(void *));
+    transcoder->frame_buf.push_back(std::move(handle));
     transcoder->last_frame_ts = new_frame->timestamp;
+}
 
-    transcoder->frame_buf_mutex.unlock();
+void SourceTranscoder::tick(uint64_t video_time, uint32_t count) {
+    // only pick the frame under the lock, the scale works on the frame handle
+    uint64_t select_start = os_gettime_ns();
+    std::shared_ptr<obs_source_frame> frame;
+    {
+        auto lock = lock_frame_buf();
+        frame = get_closest_frame(video_time);
+    }
+    select_ns += os_gettime_ns() - select_start;
+    ticks++;
+
+    if (frame) {
+        // no new input since the last tick, e.g. the network source stalled
+        if (frame == last_tick_frame) {
+            repeated_frames++;
+        }
+        last_tick_frame = frame;
+
+        timing_adjust = video_time - frame->timestamp;
+        if (count > 1) {
+            blog(LOG_INFO, "[%s] video lagged: %d", source->id.c_str(), count);
+        }
+        for (auto v : videos) {
+            output_video_frame(v, frame, count, video_time);
+        }
+    }
+    last_video_time = video_time;
 }
 
-void SourceTranscoder::video_output_callback(void *param) {
-    auto *transcoder = (SourceTranscoder *) param;
-    const struct video_output_info *voi = video_output_get_info(transcoder->video);
-    uint64_t interval = util_mul_div64(1000000000UL, voi->fps_den, voi->fps_num);
-    transcoder->last_video_time = os_gettime_ns();
-
-    while (!transcoder->video_stop) {
-        uint64_t video_time = transcoder->last_video_time + interval;
-        uint32_t count;
-        if (os_sleepto_ns(video_time)) {
-            count = 1;
-        } else {
-            count = (int) ((os_gettime_ns() - transcoder->last_video_time) / interval);
-            video_time = transcoder->last_video_time + interval * count;
+void SourceTranscoder::output_video_frame(TranscoderVideo *v, const std::shared_ptr<obs_source_frame> &frame,
+                                          uint32_t count, uint64_t video_time) {
+    bool repeat = frame == v->last_frame;
+    bool passthrough = !repeat && can_passthrough(v, frame.get());
+
+    // the scaler follows the input geometry, which may change mid-stream
+    TranscoderScaler *scaler = nullptr;
+    if (!repeat && !passthrough) {
+        scaler = get_video_scaler(v, frame.get(), video_time);
+        if (!scaler) {
+            return;
         }
+    }
 
-        transcoder->frame_buf_mutex.lock();
-        auto frame = transcoder->get_closest_frame(video_time);
-        if (frame) {
-            transcoder->timing_mutex.lock();
-            transcoder->timing_adjust = video_time - frame->timestamp;
-            transcoder->timing_mutex.unlock();
-            struct video_frame output_frame = {};
-            if (count > 1) {
-                blog(LOG_INFO, "[%s] video lagged: %d", transcoder->source->id.c_str(), count);
-            }
-            if (video_output_lock_frame(transcoder->video, &output_frame, count, video_time)) {
-                video_scaler_scale(
-                        transcoder->video_scaler,
-                        output_frame.data,
-                        output_frame.linesize,
-                        frame->data,
-                        frame->linesize
-                );
-                video_output_unlock_frame(transcoder->video);
-            }
+    struct video_frame output_frame = {};
+    if (!video_output_lock_frame(v->video, &output_frame, (int) count, video_time)) {
+        return;
+    }
+
+    uint64_t convert_start = os_gettime_ns();
+    if (repeat) {
+        // same input as last time, re-submit the previous output instead of converting again.
+        // We are the only writer of the output cache, so the previous slot still holds it.
+        if (output_frame.data[0] != v->last_output.data[0]) {
+            const struct video_output_info *voi = video_output_get_info(v->video);
+            copy_planes(output_frame.data, output_frame.linesize, v->last_output.data, v->last_output.linesize,
+                        voi->format, voi->width, voi->height);
         }
-        transcoder->last_video_time = video_time;
-        transcoder->frame_buf_mutex.unlock();
+    } else if (passthrough) {
+        // same geometry and format, copy the planes directly into the output frame
+        copy_frame_planes(&output_frame, frame.get());
+        v->passthrough_frames++;
+    } else {
+        scale_video_frame(v, scaler, &output_frame, frame.get());
     }
+    v->convert_ns += os_gettime_ns() - convert_start;
+    v->frames++;
+    v->last_frame = frame;
+    v->last_output = output_frame;
+    video_output_unlock_frame(v->video);
 }
 
 void SourceTranscoder::audio_capture_callback(void *param, obs_source_t *source, const struct audio_data *audio_data,
@@ -201,50 +333,130 @@ void SourceTranscoder::audio_capture_callback(void *param, obs_source_t *source,
 
     auto transcoder = (SourceTranscoder *) param;
 
-    size_t channels = audio_output_get_channels(transcoder->audio);
-    size_t rate = audio_output_get_sample_rate(transcoder->audio);
-
-    transcoder->timing_mutex.lock();
     uint64_t timing_adjust = transcoder->timing_adjust;
-    transcoder->timing_mutex.unlock();
-
-    if (!timing_adjust) {
+    if (transcoder->audio_only) {
+        // audio only, map the source timestamps onto the output clock directly,
+        // and again whenever the source timeline jumps
+        uint64_t now = os_gettime_ns();
+        if (!timing_adjust || uint64_diff(audio_data->timestamp + timing_adjust, now) > AUDIO_RESET_THRESHOLD) {
+            timing_adjust = now - audio_data->timestamp;
+            transcoder->timing_adjust = timing_adjust;
+        }
+    } else if (!timing_adjust) {
         return;
     }
 
-    transcoder->audio_buf_mutex.lock();
+    // never blocks, the timeline is handled on the audio output thread
+    if (!transcoder->audio_ring.push(audio_data->timestamp + timing_adjust, audio_data->data, audio_data->frames)) {
+        transcoder->audio_overflows++;
+    }
+}
 
-    uint64_t current_audio_time = audio_data->timestamp + timing_adjust;
-    size_t audio_size = audio_data->frames * sizeof(float);
+void SourceTranscoder::buffer_audio_packet(AudioRingPacket *packet) {
+    size_t channels = audio_output_get_channels(audio);
+    size_t rate = audio_output_get_sample_rate(audio);
+
+    uint64_t current_audio_time = packet->timestamp;
+    size_t audio_size = packet->frames * sizeof(float);
 
     // if audio time output range, reset audio
-    if (!transcoder->audio_time || current_audio_time < transcoder->audio_time ||
-        current_audio_time - transcoder->audio_time > AUDIO_RESET_THRESHOLD) {
-        blog(LOG_INFO, "[%s] audio timestamp reset %llu -> %llu",
-             transcoder->source->id.c_str(), current_audio_time, transcoder->audio_time);
-        transcoder->reset_audio();
-        transcoder->audio_time = current_audio_time;
-        transcoder->last_audio_time = current_audio_time;
+    if (!audio_time || current_audio_time < audio_time || current_audio_time - audio_time > AUDIO_RESET_THRESHOLD) {
+        blog(LOG_INFO, "[%s] audio timestamp reset %llu -> %llu", source->id.c_str(), current_audio_time, audio_time);
+        reset_audio();
+        audio_time = current_audio_time;
+        last_audio_time = current_audio_time;
     }
 
-    uint64_t diff = uint64_diff(transcoder->last_audio_time, current_audio_time);
+    uint64_t diff = uint64_diff(last_audio_time, current_audio_time);
     if (diff > AUDIO_SMOOTH_THRESHOLD) {
-        blog(LOG_INFO, "[%s] audio buffer placement: %llu", transcoder->source->id.c_str(), diff);
-        size_t buf_placement = ns_to_audio_frames(rate, current_audio_time - transcoder->audio_time) * sizeof(float);
+        // too far off to be absorbed by rate adjustment, jump to the packet timestamp
+        blog(LOG_INFO, "[%s] audio buffer placement: %llu", source->id.c_str(), diff);
+        size_t buf_placement = ns_to_audio_frames(rate, current_audio_time - audio_time) * sizeof(float);
         for (size_t i = 0; i < channels; i++) {
-            circlebuf_place(&transcoder->audio_buf[i], buf_placement, audio_data->data[i], audio_size);
-            circlebuf_pop_back(&transcoder->audio_buf[i], nullptr,
-                               transcoder->audio_buf[i].size - (buf_placement + audio_size));
+            circlebuf_place(&audio_buf[i], buf_placement, packet->data[i], audio_size);
+            circlebuf_pop_back(&audio_buf[i], nullptr, audio_buf[i].size - (buf_placement + audio_size));
+            resample_last[i] = packet->data[i][packet->frames - 1];
         }
-        transcoder->last_audio_time = current_audio_time;
+        last_audio_time = current_audio_time + audio_frames_to_ns(rate, packet->frames);
+        resample_pos = 0.0;
+        resample_ratio = 1.0;
+        drift_error = 0.0;
+        drift_ppm = 0;
+        drift_corrections++;
+        return;
+    }
+
+    // the source clock drifts against the output clock, stretch or squeeze the packet
+    // slightly so that the sample timeline follows the source timestamps
+    drift_error = drift_error * 0.95 + (double) (int64_t) (current_audio_time - last_audio_time) * 0.05;
+    double target = 1.0;
+    if (std::abs(drift_error) > AUDIO_DRIFT_DEADBAND) {
+        target += std::clamp(drift_error / AUDIO_DRIFT_WINDOW, -AUDIO_MAX_DRIFT, AUDIO_MAX_DRIFT);
+    }
+
+    // slew towards the target ratio so that the pitch never jumps between packets
+    if (std::abs(target - resample_ratio) <= AUDIO_DRIFT_SLEW) {
+        resample_ratio = target;
     } else {
+        resample_ratio += target > resample_ratio ? AUDIO_DRIFT_SLEW : -AUDIO_DRIFT_SLEW;
+    }
+    drift_ppm = (int64_t) ((resample_ratio - 1.0) * 1000000.0);
+
+    if (resample_ratio == 1.0 && std::abs(resample_pos) < AUDIO_RESAMPLE_EPSILON) {
+        resample_pos = 0.0;
         for (size_t i = 0; i < channels; i++) {
-            circlebuf_push_back(&transcoder->audio_buf[i], audio_data->data[i], audio_size);
+            circlebuf_push_back(&audio_buf[i], packet->data[i], audio_size);
+            resample_last[i] = packet->data[i][packet->frames - 1];
+        }
+        last_audio_time += audio_frames_to_ns(rate, packet->frames);
+        return;
+    }
+
+    double ratio = resample_ratio;
+    if (ratio == 1.0) {
+        // back at the nominal rate but between two input samples, emit exactly one packet worth
+        // of frames that ends on the input grid so the next packet takes the copy path again
+        ratio = (double) packet->frames / ((double) packet->frames - resample_pos);
+    }
+
+    size_t out_frames = resample_audio_packet(packet, channels, ratio);
+    for (size_t i = 0; i < channels; i++) {
+        circlebuf_push_back(&audio_buf[i], resample_buf.data() + i * (resample_buf.size() / channels),
+                            out_frames * sizeof(float));
+    }
+    last_audio_time += audio_frames_to_ns(rate, out_frames);
+}
+
+size_t SourceTranscoder::resample_audio_packet(AudioRingPacket *packet, size_t channels, double ratio) {
+    // linear interpolation, position -1 is the last sample of the previous packet
+    double step = 1.0 / ratio;
+    size_t capacity = (size_t) (packet->frames * ratio) + 2;
+    if (resample_buf.size() < capacity * channels) {
+        resample_buf.resize(capacity * channels);
+    }
+    size_t stride = resample_buf.size() / channels;
+
+    size_t out_frames = 0;
+    double pos = resample_pos;
+    double last = packet->frames - 1;
+    while (pos <= last && out_frames < capacity) {
+        auto index = (int64_t) std::floor(pos);
+        float frac = (float) (pos - index);
+        for (size_t ch = 0; ch < channels; ch++) {
+            const float *in = packet->data[ch];
+            float a = index < 0 ? resample_last[ch] : in[index];
+            float b = index + 1 < packet->frames ? in[index + 1] : a;
+            resample_buf[ch * stride + out_frames] = a + (b - a) * frac;
         }
+        out_frames++;
+        pos += step;
     }
+    resample_pos = pos - packet->frames;
 
-    transcoder->last_audio_time += audio_frames_to_ns(rate, audio_data->frames);
-    transcoder->audio_buf_mutex.unlock();
+    for (size_t ch = 0; ch < channels; ch++) {
+        resample_last[ch] = packet->data[ch][packet->frames - 1];
+    }
+    return out_frames;
 }
 
 bool SourceTranscoder::audio_output_callback(
@@ -261,7 +473,12 @@ bool SourceTranscoder::audio_output_callback(
     size_t rate = audio_output_get_sample_rate(transcoder->audio);
     ts_info ts = {start_ts_in, end_ts_in};
 
-    transcoder->audio_buf_mutex.lock();
+    // move everything captured since the last call onto the timeline
+    AudioRingPacket *packet;
+    while ((packet = transcoder->audio_ring.front())) {
+        transcoder->buffer_audio_packet(packet);
+        transcoder->audio_ring.pop();
+    }
 
     circlebuf_push_back(&transcoder->audio_timestamp_buf, &ts, sizeof(ts));
     circlebuf_peek_front(&transcoder->audio_timestamp_buf, &ts, sizeof(ts));
@@ -313,6 +530,7 @@ bool SourceTranscoder::audio_output_callback(
             blog(LOG_INFO, "[%s] audio timestamp buffer exceed limit: %llu, audio time: %llu, ts.end: %llu",
                  transcoder->source->id.c_str(), end_ts_in - ts.start, transcoder->audio_time, ts.end);
             transcoder->reset_audio();
+            transcoder->audio_underruns++;
             result = true;
         }
     }
@@ -321,14 +539,101 @@ bool SourceTranscoder::audio_output_callback(
         circlebuf_pop_front(&transcoder->audio_timestamp_buf, nullptr, sizeof(ts));
     }
 
-    transcoder->audio_buf_mutex.unlock();
-
     *out_ts = ts.start;
     return result;
 }
 
-void SourceTranscoder::create_video_scaler(obs_source_frame *frame) {
-    const struct video_output_info *voi = video_output_get_info(video);
+TranscoderVideo *SourceTranscoder::get_or_create_video(Output *output, OutputSettings *settings) {
+    video_format format = output->getVideoFormat();
+    video_scale_type scale_type = output->getScaleType();
+    std::string key = std::to_string(settings->width) + "x" + std::to_string(settings->height) + "_" +
+                      get_video_format_name(format) + "_" + settings->scaleType;
+    for (auto v : videos) {
+        if (v->key == key) {
+            v->renditions++;
+            return v;
+        }
+    }
+
+    obs_video_info ovi = {};
+    obs_get_video_info(&ovi);
+
+    video_output_info voi = {};
+    std::string videoOutputName = std::string("source_video_output_") + source->id + "_" + key;
+    voi.name = videoOutputName.c_str();
+    voi.format = format;
+    voi.width = settings->width;
+    voi.height = settings->height;
+    voi.fps_num = ovi.fps_num;
+    voi.fps_den = ovi.fps_den;
+    voi.cache_size = 16;
+
+    auto v = new TranscoderVideo();
+    v->key = key;
+    v->video = nullptr;
+    v->scale_type = scale_type;
+    v->scale_type_name = settings->scaleType;
+    v->renditions = 1;
+    if (video_output_open(&v->video, &voi) != VIDEO_OUTPUT_SUCCESS) {
+        delete v;
+        throw std::runtime_error("Failed to open video output " + videoOutputName);
+    }
+    videos.push_back(v);
+    return v;
+}
+
+TranscoderScaler *SourceTranscoder::get_video_scaler(TranscoderVideo *v, obs_source_frame *frame, uint64_t video_time) {
+    // evict scalers of input geometries that are no longer seen
+    for (auto it = v->scalers.begin(); it != v->scalers.end();) {
+        bool matched = it->format == frame->format && it->width == frame->width && it->height == frame->height &&
+                       it->full_range == frame->full_range;
+        if (!matched && video_time - it->last_used > SCALER_EVICT_THRESHOLD) {
+            blog(LOG_INFO, "[%s] video scaler evicted for %s: %dx%d %s",
+                 source->id.c_str(), v->key.c_str(), it->width, it->height, get_video_format_name(it->format));
+            destroy_video_scaler(&*it);
+            it = v->scalers.erase(it);
+            scalers_evicted++;
+        } else {
+            ++it;
+        }
+    }
+
+    for (auto &entry : v->scalers) {
+        if (entry.format == frame->format && entry.width == frame->width && entry.height == frame->height &&
+            entry.full_range == frame->full_range) {
+            entry.last_used = video_time;
+            return &entry;
+        }
+    }
+
+    TranscoderScaler created = {frame->format, frame->width, frame->height, frame->full_range, nullptr, {},
+                                video_time};
+    if (!create_video_scaler(v, frame, &created)) {
+        return nullptr;
+    }
+
+    if (v->scalers.size() >= SCALER_CACHE_SIZE) {
+        auto lru = v->scalers.begin();
+        for (auto it = v->scalers.begin(); it != v->scalers.end(); ++it) {
+            if (it->last_used < lru->last_used) {
+                lru = it;
+            }
+        }
+        destroy_video_scaler(&*lru);
+        v->scalers.erase(lru);
+        scalers_evicted++;
+    }
+
+    blog(LOG_INFO, "[%s] video scaler created for %s: %dx%d %s%s, %d slices",
+         source->id.c_str(), v->key.c_str(), frame->width, frame->height, get_video_format_name(frame->format),
+         frame->full_range ? " full range" : "", (int) created.slices.size());
+    v->scalers.push_back(std::move(created));
+    scalers_created++;
+    return &v->scalers.back();
+}
+
+bool SourceTranscoder::create_video_scaler(TranscoderVideo *v, obs_source_frame *frame, TranscoderScaler *entry) {
+    const struct video_output_info *voi = video_output_get_info(v->video);
     struct video_scale_info src = {
             .format = frame->format,
             .width = frame->width,
@@ -344,19 +649,66 @@ void SourceTranscoder::create_video_scaler(obs_source_frame *frame) {
             .colorspace = VIDEO_CS_DEFAULT
     };
 
-    int ret = video_scaler_create(&video_scaler, &dest, &src, VIDEO_SCALE_FAST_BILINEAR);
+    // large inputs are split into horizontal bands, each band has its own scaler with overlapping
+    // margins so that the kept rows are the same as those of a single scaler
+    size_t slice_count = std::min<size_t>(std::thread::hardware_concurrency(), SCALER_MAX_SLICES);
+    bool sliced = source->settings->scaleSliceThreshold > 0 &&
+                  (uint64_t) frame->width * frame->height > (uint64_t) source->settings->scaleSliceThreshold &&
+                  slice_count > 1;
+    if (sliced && create_scale_slices(entry->slices, &dest, &src, v->scale_type, slice_count)) {
+        return true;
+    }
+    if (sliced) {
+        blog(LOG_INFO, "[%s] %dx%d -> %dx%d can't be sliced exactly for %s, scaling in one piece",
+             source->id.c_str(), frame->width, frame->height, voi->width, voi->height, v->key.c_str());
+    }
+
+    int ret = video_scaler_create(&entry->scaler, &dest, &src, v->scale_type);
     if (ret != VIDEO_SCALER_SUCCESS) {
-        throw std::runtime_error("Failed to create video scaler.");
+        blog(LOG_ERROR, "[%s] Failed to create video scaler for %s", source->id.c_str(), v->key.c_str());
+        entry->scaler = nullptr;
+        return false;
     }
+    return true;
 }
 
-obs_source_frame *SourceTranscoder::get_closest_frame(uint64_t video_time) {
-    if (!frame_buf.size) {
+void SourceTranscoder::scale_video_frame(TranscoderVideo *v, TranscoderScaler *entry, struct video_frame *output,
+                                         obs_source_frame *frame) {
+    if (entry->slices.empty()) {
+        video_scaler_scale(entry->scaler, output->data, output->linesize, frame->data, frame->linesize);
+        return;
+    }
+
+    // every band writes its own rows of the output, the result doesn't depend on scheduling
+    auto scale_slice_at = [&](size_t i) {
+        scale_slice(entry->slices[i], output->data, output->linesize, frame->data, frame->linesize);
+    };
+
+    WorkerPool *pool = TranscoderScheduler::getInstance().getWorkerPool();
+    if (pool) {
+        pool->parallelFor(entry->slices.size(), scale_slice_at);
+    } else {
+        for (size_t i = 0; i < entry->slices.size(); i++) {
+            scale_slice_at(i);
+        }
+    }
+    v->sliced_frames++;
+}
+
+void SourceTranscoder::destroy_video_scaler(TranscoderScaler *entry) {
+    if (entry->scaler) {
+        video_scaler_destroy(entry->scaler);
+        entry->scaler = nullptr;
+    }
+    destroy_scale_slices(entry->slices);
+}
+
+std::shared_ptr<obs_source_frame> SourceTranscoder::get_closest_frame(uint64_t video_time) {
+    if (frame_buf.empty()) {
         return nullptr;
     }
 
-    obs_source_frame *frame;
-    circlebuf_peek_front(&frame_buf, &frame, sizeof(void *));
+    auto frame = frame_buf.front();
 
     if (!last_video_time) {
         last_video_time = video_time;
@@ -368,24 +720,41 @@ obs_source_frame *SourceTranscoder::get_closest_frame(uint64_t video_time) {
 
     uint64_t sys_offset = video_time - last_video_time;
     uint64_t frame_ts = sys_offset + last_frame_ts;
-    while (frame_ts > frame->timestamp && frame_buf.size > sizeof(void *)) {
+    while (frame_ts > frame->timestamp && frame_buf.size() > 1) {
         if (frame_ts - frame->timestamp < VIDEO_SMOOTH_THRESHOLD) {
             break;
         }
-        circlebuf_pop_front(&frame_buf, &frame, sizeof(void *));
-        obs_source_frame_destroy(frame);
-        circlebuf_peek_front(&frame_buf, &frame, sizeof(void *));
+        frame_buf.pop_front();
+        frame = frame_buf.front();
     }
     last_frame_ts = frame_ts;
     return frame;
 }
 
-void SourceTranscoder::reset_video() {
-    while (frame_buf.size > 0) {
-        obs_source_frame *frame = nullptr;
-        circlebuf_pop_front(&frame_buf, &frame, sizeof(void *));
-        obs_source_frame_destroy(frame);
+bool SourceTranscoder::can_passthrough(TranscoderVideo *v, obs_source_frame *frame) {
+    const struct video_output_info *voi = video_output_get_info(v->video);
+    if (frame->format != voi->format || frame->width != voi->width || frame->height != voi->height) {
+        return false;
+    }
+    plane_info planes[MAX_AV_PLANES] = {};
+    if (!get_planes(frame->format, frame->width, frame->height, planes)) {
+        return false;
+    }
+    // the output is always limited range, full range yuv still needs the scaler
+    return !format_is_yuv(frame->format) || !frame->full_range;
+}
+
+std::unique_lock<std::mutex> SourceTranscoder::lock_frame_buf() {
+    std::unique_lock<std::mutex> lock(frame_buf_mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        frame_buf_contention++;
+        lock.lock();
     }
+    return lock;
+}
+
+void SourceTranscoder::reset_video() {
+    frame_buf.clear();
     last_frame_ts = 0;
 }
 
@@ -396,4 +765,8 @@ void SourceTranscoder::reset_audio() {
     }
     audio_time = 0;
     last_audio_time = 0;
+    resample_pos = 0.0;
+    resample_ratio = 1.0;
+    drift_error = 0.0;
+    drift_ppm = 0;
 }
@@ -1,31 +1,96 @@
 #pragma once
 
 #include "output.h"
+#include "frame_pool.h"
+#include "audio_ring.h"
+#include "scale_slices.h"
+#include <atomic>
+#include <deque>
 #include <memory>
 #include <mutex>
-#include <thread>
+#include <vector>
 #include <obs.h>
 #include <util/circlebuf.h>
 #include <media-io/video-scaler.h>
-#include <media-io/audio-resampler.h>
 
 class Source;
 
+struct TranscoderScaler {
+	enum video_format format;
+	uint32_t width;
+	uint32_t height;
+	bool full_range;
+	video_scaler_t *scaler;
+	std::vector<ScaleSliceScaler> slices;
+	uint64_t last_used;
+};
+
+// Scaled video output, shared by all renditions with the same size, format and scale type.
+struct TranscoderVideo {
+	std::string key;
+	video_t *video;
+	enum video_scale_type scale_type;
+	std::string scale_type_name;
+	std::vector<TranscoderScaler> scalers;
+	std::shared_ptr<obs_source_frame> last_frame;
+	struct video_frame last_output;
+	int renditions;
+	std::atomic<uint64_t> frames;
+	std::atomic<uint64_t> passthrough_frames;
+	std::atomic<uint64_t> sliced_frames;
+	std::atomic<uint64_t> convert_ns;
+};
+
+struct TranscoderVideoStats {
+	uint32_t width;
+	uint32_t height;
+	std::string format;
+	std::string scaleType;
+	int renditions;
+	uint64_t frames;
+	uint64_t passthroughFrames;
+	uint64_t slicedFrames;
+	uint64_t avgConvertNs;
+};
+
+struct TranscoderStats {
+	uint64_t framePoolHits;
+	uint64_t framePoolMisses;
+	size_t framePoolSize;
+	uint64_t frameLockContention;
+	uint64_t avgCaptureNs;
+	uint64_t avgSelectNs;
+	uint64_t repeatedFrames;
+	uint64_t scalersCreated;
+	uint64_t scalersEvicted;
+	uint64_t audioOverflows;
+	uint64_t audioUnderruns;
+	int64_t driftPpm;
+	uint64_t driftCorrections;
+	std::vector<TranscoderVideoStats> videos;
+};
+
 class SourceTranscoder {
 
+friend class TranscoderScheduler;
+
 public:
 	SourceTranscoder();
 
-	void start(Source *source);
+	void start(Source *source, const std::vector<OutputSettings *> &outputSettings);
 
 	void stop();
 
+	TranscoderStats getStats();
+
+	std::vector<Output *> &getOutputs();
+
 private:
 	static void source_media_get_frame_callback(
 			void *param,
 			calldata_t *data);
 
-	static void video_output_callback(void *param);
+	void tick(uint64_t video_time, uint32_t count);
 
 	static bool audio_output_callback(
 			void *param,
@@ -43,33 +108,74 @@ private:
 			bool muted
 	);
 
-	void create_video_scaler(obs_source_frame *frame);
+	void buffer_audio_packet(AudioRingPacket *packet);
+
+	size_t resample_audio_packet(AudioRingPacket *packet, size_t channels, double ratio);
+
+	TranscoderVideo *get_or_create_video(Output *output, OutputSettings *settings);
+
+	void output_video_frame(
+			TranscoderVideo *v,
+			const std::shared_ptr<obs_source_frame> &frame,
+			uint32_t count,
+			uint64_t video_time
+	);
 
-	obs_source_frame *get_closest_frame(uint64_t video_time);
+	TranscoderScaler *get_video_scaler(TranscoderVideo *v, obs_source_frame *frame, uint64_t video_time);
+
+	bool create_video_scaler(TranscoderVideo *v, obs_source_frame *frame, TranscoderScaler *entry);
+
+	void scale_video_frame(TranscoderVideo *v, TranscoderScaler *entry, struct video_frame *output,
+	                       obs_source_frame *frame);
+
+	static void destroy_video_scaler(TranscoderScaler *entry);
+
+	std::shared_ptr<obs_source_frame> get_closest_frame(uint64_t video_time);
+
+	std::unique_lock<std::mutex> lock_frame_buf();
+
+	static bool can_passthrough(TranscoderVideo *v, obs_source_frame *frame);
 
 	void reset_video();
 
 	void reset_audio();
 
 	Source *source;
-	Output *output;
+	std::vector<Output *> outputs;
 
-	video_t *video;
-	circlebuf frame_buf;
+	std::vector<TranscoderVideo *> videos;
+	bool audio_only;
+	std::deque<std::shared_ptr<obs_source_frame>> frame_buf;
+	FramePool frame_pool;
 	std::mutex frame_buf_mutex;
-	video_scaler_t *video_scaler;
+	std::atomic<uint64_t> frame_buf_contention;
+	std::atomic<uint64_t> captured_frames;
+	std::atomic<uint64_t> capture_ns;
+	std::atomic<uint64_t> ticks;
+	std::atomic<uint64_t> select_ns;
+	std::shared_ptr<obs_source_frame> last_tick_frame;
+	std::atomic<uint64_t> repeated_frames;
+	std::atomic<uint64_t> scalers_created;
+	std::atomic<uint64_t> scalers_evicted;
 	uint64_t last_video_time;
 	uint64_t last_frame_ts;
-	std::thread video_thread;
-	volatile bool video_stop;
 
+	// audio_buf, audio_timestamp_buf and the audio times are only touched by the audio output thread
 	audio_t *audio;
+	AudioRing audio_ring;
 	circlebuf audio_buf[MAX_AUDIO_CHANNELS];
-	std::mutex audio_buf_mutex;
 	circlebuf audio_timestamp_buf;
 	uint64_t audio_time;
 	uint64_t last_audio_time;
-
-	int64_t timing_adjust;
-	std::mutex timing_mutex;
+	std::atomic<uint64_t> audio_overflows;
+	std::atomic<uint64_t> audio_underruns;
+	std::vector<float> resample_buf;
+	float resample_last[MAX_AUDIO_CHANNELS];
+	double resample_pos;
+	double resample_ratio;
+	double drift_error;
+	std::atomic<int64_t> drift_ppm;
+	std::atomic<uint64_t> drift_corrections;
+
+	std::atomic<int64_t> timing_adjust;
 };
\ No newline at end of file
@@ -1,24 +1,65 @@
 #include "studio.h"
+#include "audio_only_output.h"
+#include "command_queue.h"
 #include <filesystem>
 #include <mutex>
 #include <obs.h>
+#include <util/platform.h>
+#include <algorithm>
+#include <thread>
+
+// above the transition on channel 0, below the overlays
+#define OBS_DSK_CHANNEL 1
 
 std::mutex scenes_mtx;
 std::string Studio::obsPath;
 
 Studio::Studio(Settings *settings) :
           settings(settings),
+          dsk_scene(nullptr),
+          overlays(),
           currentScene(nullptr),
-          outputs(),
-          overlays() {
+          startingSources(),
+          busySources(),
+          orphanedSources(),
+          prepares_mutex(),
+          prepares_cv(),
+          prepares(),
+          switch_stats_mutex(),
+          pendingSwitchStart(0),
+          switches(0),
+          lastDispatchNs(0),
+          totalDispatchNs(0),
+          maxDispatchNs(0),
+          completed(0),
+          lastCompleteNs(0),
+          totalCompleteNs(0),
+          maxCompleteNs(0),
+          outputs() {
+    for (size_t i = 0; i < settings->outputs.size(); i++) {
+        auto o = settings->outputs[i];
+        if (o->id.empty()) {
+            o->id = "output" + std::to_string(i);
+        }
+    }
+    // ids are checked before any output exists, a default id may collide with an explicit one
+    for (size_t i = 0; i < settings->outputs.size(); i++) {
+        for (size_t j = 0; j < i; j++) {
+            if (settings->outputs[i]->id == settings->outputs[j]->id) {
+                throw std::invalid_argument("Duplicate output id: " + settings->outputs[i]->id);
+            }
+        }
+    }
     for (auto o : settings->outputs) {
-        outputs.push_back(new Output(o));
+        outputs[o->id] = new Output(o);
     }
 }
 
 Studio::~Studio() {
-    for (auto output : outputs) {
-        delete output;
+    // shutdown joined them already unless it wasn't called
+    cancelPrepares(nullptr);
+    for (auto &output : outputs) {
+        delete output.second;
     }
 }
 
@@ -38,6 +79,8 @@ void Studio::startup() {
         if (!obs_initialized()) {
             throw std::runtime_error("Failed to startup obs studio.");
         }
+        AudioOnlyOutput::registerOutput();
+        Encoder::registerLatencyProbe();
 
         // reset video
         if (settings->video) {
@@ -96,8 +139,8 @@ void Studio::startup() {
 
         obs_post_load_modules();
 
-        for (auto output : outputs) {
-            output->start(obs_get_video(), obs_get_audio());
+        for (auto &output : outputs) {
+            output.second->start(obs_get_video(), obs_get_audio());
         }
 
         restore();
@@ -109,8 +152,27 @@ void Studio::startup() {
 }
 
 void Studio::shutdown() {
-    for (auto output : outputs) {
-        output->stop();
+    for (auto &output : outputs) {
+        output.second->stop();
+    }
+    cancelPrepares(nullptr);
+    std::map<std::string, Scene *> removed;
+    {
+        std::unique_lock<std::mutex> lock(scenes_mtx);
+        removed.swap(scenes);
+        currentScene = nullptr;
+    }
+    for (auto &scene : removed) {
+        delete scene.second;
+    }
+    for (auto &dsk : dsks) {
+        delete dsk.second;
+    }
+    dsks.clear();
+    if (dsk_scene) {
+        obs_set_output_source(OBS_DSK_CHANNEL, nullptr);
+        obs_scene_release(dsk_scene);
+        dsk_scene = nullptr;
     }
     obs_shutdown();
     if (obs_initialized()) {
@@ -125,12 +187,164 @@ void Studio::addScene(std::string &sceneId) {
     scenes[sceneId] = scene;
 }
 
+void Studio::removeScene(std::string &sceneId) {
+    Scene *scene;
+    {
+        std::unique_lock<std::mutex> lock(scenes_mtx);
+        scene = findScene(sceneId);
+        if (scene == currentScene) {
+            throw std::logic_error("Can't remove scene " + sceneId + " on air");
+        }
+        auto &sources = scene->getSources();
+        for (auto it = sources.begin(); it != sources.end();) {
+            if (busySources.count(it->second)) {
+                orphanedSources.insert(it->second);
+                it = sources.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        scenes.erase(sceneId);
+    }
+    // stops the sources, unpublished already
+    delete scene;
+}
+
 void Studio::addSource(std::string &sceneId, std::string &sourceId, std::shared_ptr<SourceSettings> &settings) {
-    findScene(sceneId)->addSource(sourceId, settings);
+    std::string key = sceneId + "/" + sourceId;
+    obs_scene_t *obs_scene;
+    {
+        std::unique_lock<std::mutex> lock(scenes_mtx);
+        Scene *scene = findScene(sceneId);
+        if (scene->getSources().count(sourceId) || startingSources.count(key)) {
+            throw std::logic_error("Source " + sourceId + " already existed");
+        }
+        startingSources.insert(key);
+        // our own reference, the scene may be removed while the source starts
+        obs_scene = scene->getObsScene();
+        obs_scene_addref(obs_scene);
+    }
+
+    // Opening the media and setting up its outputs takes a while, the scene lock isn't held meanwhile.
+    auto source = new Source(sourceId, sceneId, obs_scene, settings, [this, sceneId, sourceId](const std::string &outputId) {
+        // called on the relay thread, the transcoder is started on the control thread like a restart
+        CommandQueue::getInstance().post([this, sceneId, sourceId, outputId]() mutable {
+            try {
+                runBusy(sceneId, sourceId, [&outputId](Source *source) {
+                    source->fallbackRelay(outputId);
+                });
+            } catch (const std::exception &e) {
+                blog(LOG_WARNING, "[%s] failed to start the fallback transcoder of %s: %s", sourceId.c_str(),
+                     outputId.c_str(), e.what());
+            }
+        });
+    });
+    std::exception_ptr error;
+    try {
+        source->start();
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    // a source that failed to start is kept, the same as before, so it can be restarted
+    bool published = false;
+    {
+        std::unique_lock<std::mutex> lock(scenes_mtx);
+        startingSources.erase(key);
+        auto found = scenes.find(sceneId);
+        if (found != scenes.end() && found->second->getObsScene() == obs_scene) {
+            found->second->addSource(source);
+            published = true;
+        }
+    }
+    if (!published) {
+        source->stop();
+        delete source;
+    }
+    obs_scene_release(obs_scene);
+
+    if (!published) {
+        throw std::logic_error("Scene " + sceneId + " was removed while source " + sourceId + " was starting");
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
 }
 
-Source *Studio::findSource(std::string &sceneId, std::string &sourceId) {
-    return findScene(sceneId)->findSource(sourceId);
+void Studio::removeSource(std::string &sceneId, std::string &sourceId) {
+    Source *source;
+    {
+        std::unique_lock<std::mutex> lock(scenes_mtx);
+        source = findScene(sceneId)->takeSource(sourceId);
+        if (busySources.count(source)) {
+            orphanedSources.insert(source);
+            return;
+        }
+    }
+    source->stop();
+    delete source;
+}
+
+void Studio::restartSource(std::string &sceneId, std::string &sourceId) {
+    runBusy(sceneId, sourceId, [](Source *source) {
+        source->restart();
+    });
+}
+
+void Studio::setSourceUrl(std::string &sceneId, std::string &sourceId, const std::string &url) {
+    runBusy(sceneId, sourceId, [&url](Source *source) {
+        source->setUrl(url);
+    });
+}
+
+void Studio::withSource(std::string &sceneId, std::string &sourceId, const std::function<void(Source *)> &fn) {
+    std::unique_lock<std::mutex> lock(scenes_mtx);
+    Source *source = findScene(sceneId)->findSource(sourceId);
+    if (busySources.count(source)) {
+        throw std::logic_error("Source " + sourceId + " is restarting");
+    }
+    fn(source);
+}
+
+void Studio::runBusy(std::string &sceneId, std::string &sourceId, const std::function<void(Source *)> &fn) {
+    Source *source;
+    obs_scene_t *obs_scene;
+    {
+        std::unique_lock<std::mutex> lock(scenes_mtx);
+        Scene *scene = findScene(sceneId);
+        source = scene->findSource(sourceId);
+        if (busySources.count(source)) {
+            throw std::logic_error("Source " + sourceId + " is restarting");
+        }
+        busySources.insert(source);
+        // the source adds its scene item to it again
+        obs_scene = scene->getObsScene();
+        obs_scene_addref(obs_scene);
+    }
+
+    std::exception_ptr error;
+    try {
+        fn(source);
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    // removed meanwhile, by removeSource or removeScene
+    bool orphaned;
+    {
+        std::unique_lock<std::mutex> lock(scenes_mtx);
+        busySources.erase(source);
+        orphaned = orphanedSources.erase(source) > 0;
+    }
+    if (orphaned) {
+        source->stop();
+        delete source;
+    }
+    obs_scene_release(obs_scene);
+
+    if (error && !orphaned) {
+        std::rethrow_exception(error);
+    }
 }
 
 void Studio::addDSK(std::string &id, std::string &position, std::string &url, int left, int top, int width, int height) {
@@ -138,11 +352,125 @@ void Studio::addDSK(std::string &id, std::string &position, std::string &url, in
     if (found != dsks.end()) {
         throw std::logic_error("Dsk " + id + " already existed");
     }
-    auto *dsk = new Dsk(id, position, url, left, top, width, height);
+    // all dsks share one scene, rendered once per frame whatever the scene count
+    if (!dsk_scene) {
+        dsk_scene = obs_scene_create_private("dsk");
+        obs_set_output_source(OBS_DSK_CHANNEL, obs_scene_get_source(dsk_scene));
+    }
+    auto *dsk = new Dsk(id, position, url, left, top, width, height, dsk_scene);
     dsks[id] = dsk;
 }
 
+void Studio::updateDSK(std::string &id, std::string &position, std::string &url, int left, int top, int width,
+                       int height) {
+    findDSK(id)->update(position, url, left, top, width, height);
+}
+
+void Studio::removeDSK(std::string &id) {
+    Dsk *dsk = findDSK(id);
+    dsks.erase(id);
+    delete dsk;
+}
+
+Dsk *Studio::findDSK(std::string &id) {
+    auto found = dsks.find(id);
+    if (found == dsks.end()) {
+        throw std::invalid_argument("Can't find dsk " + id);
+    }
+    return found->second;
+}
+
+void Studio::addOutput(OutputSettings *outputSettings) {
+    std::string id = outputSettings->id;
+    if (outputs.find(id) != outputs.end()) {
+        delete outputSettings;
+        throw std::logic_error("Output " + id + " already existed");
+    }
+    auto output = new Output(outputSettings);
+    try {
+        output->start(obs_get_video(), obs_get_audio());
+    } catch (...) {
+        output->stop();
+        delete output;
+        delete outputSettings;
+        throw;
+    }
+    // settings owns the output settings, the same as the outputs from startup
+    settings->outputs.push_back(outputSettings);
+    outputs[id] = output;
+}
+
+void Studio::removeOutput(const std::string &outputId) {
+    auto found = outputs.find(outputId);
+    if (found == outputs.end()) {
+        throw std::invalid_argument("Can't find output " + outputId);
+    }
+    Output *output = found->second;
+    outputs.erase(found);
+    output->stop();
+
+    auto &list = settings->outputs;
+    for (auto it = list.begin(); it != list.end(); ++it) {
+        if ((*it)->id == outputId) {
+            delete *it;
+            list.erase(it);
+            break;
+        }
+    }
+    delete output;
+}
+
+Output *Studio::findOutput(const std::string &outputId) {
+    auto found = outputs.find(outputId);
+    if (found == outputs.end()) {
+        throw std::invalid_argument("Can't find output " + outputId);
+    }
+    return found->second;
+}
+
+void Studio::restartOutput(const std::string &outputId) {
+    findOutput(outputId)->restart(obs_get_video(), obs_get_audio());
+}
+
+std::map<std::string, Output *> &Studio::getOutputs() {
+    return outputs;
+}
+
+std::vector<OutputStats> Studio::getOutputStats() {
+    std::vector<OutputStats> result;
+    for (auto &output : outputs) {
+        result.push_back(output.second->getStats());
+    }
+
+    std::unique_lock<std::mutex> lock(scenes_mtx);
+    for (auto &scene : scenes) {
+        for (auto &source : scene.second->getSources()) {
+            // its transcoder and relays are being replaced
+            if (busySources.count(source.second)) {
+                continue;
+            }
+            std::vector<OutputStats> sourceStats;
+            auto transcoder = source.second->getTranscoder();
+            if (transcoder) {
+                for (auto output : transcoder->getOutputs()) {
+                    sourceStats.push_back(output->getStats());
+                }
+            }
+            for (auto relay : source.second->getRelays()) {
+                sourceStats.push_back(relay->getOutputStats());
+            }
+            for (auto &stats : sourceStats) {
+                stats.sceneId = scene.first;
+                stats.sourceId = source.first;
+                result.push_back(stats);
+            }
+        }
+    }
+    return result;
+}
+
 void Studio::switchToScene(std::string &sceneId, std::string &transitionType, int transitionMs) {
+    std::unique_lock<std::mutex> scenes_lock(scenes_mtx);
     Scene *next = findScene(sceneId);
 
     if (next == currentScene) {
@@ -152,33 +480,193 @@ void Studio::switchToScene(std::string &sceneId, std::string &transitionType, in
 
     blog(LOG_INFO, "Start transition: %s -> %s", (currentScene ? currentScene->getId().c_str() : ""),
          next->getId().c_str());
+    uint64_t switchStart = os_gettime_ns();
 
     // Find or create transition
     auto it = transitions.find(transitionType);
     if (it == transitions.end()) {
-        transitions[transitionType] = obs_source_create(transitionType.c_str(), transitionType.c_str(), nullptr,
-                                                        nullptr);
+        obs_source_t *created = obs_source_create(transitionType.c_str(), transitionType.c_str(), nullptr, nullptr);
+        transitions[transitionType] = created;
+        if (created) {
+            signal_handler_connect(obs_source_get_signal_handler(created), "transition_stop",
+                                   transition_stop_callback, this);
+        }
     }
 
     obs_source_t *transition = transitions[transitionType];
     if (currentScene) {
-        obs_transition_set(transition, obs_scene_get_source(currentScene->getObsOutputScene(dsks)));
+        obs_transition_set(transition, obs_scene_get_source(currentScene->getObsScene()));
     }
 
     obs_set_output_source(0, transition);
 
+    // set before the start, a cut may stop on the next video tick already
+    {
+        std::unique_lock<std::mutex> lock(switch_stats_mutex);
+        pendingSwitchStart = switchStart;
+    }
     bool ret = obs_transition_start(
             transition,
             OBS_TRANSITION_MODE_AUTO,
             transitionMs,
-            obs_scene_get_source(next->getObsOutputScene(dsks))
+            obs_scene_get_source(next->getObsScene())
     );
 
     if (!ret) {
+        std::unique_lock<std::mutex> lock(switch_stats_mutex);
+        pendingSwitchStart = 0;
         throw std::runtime_error("Failed to start transition.");
     }
 
+    // the transition shows the scene now
+    next->unprepare();
+
     currentScene = next;
+
+    std::unique_lock<std::mutex> lock(switch_stats_mutex);
+    lastDispatchNs = os_gettime_ns() - switchStart;
+    totalDispatchNs += lastDispatchNs;
+    maxDispatchNs = std::max(maxDispatchNs, lastDispatchNs);
+    switches++;
+}
+
+void Studio::transition_stop_callback(void *param, calldata_t *) {
+    // runs on the video thread once the transition shows the next scene only
+    auto studio = (Studio *) param;
+    std::unique_lock<std::mutex> lock(studio->switch_stats_mutex);
+    if (!studio->pendingSwitchStart) {
+        return;
+    }
+    studio->lastCompleteNs = os_gettime_ns() - studio->pendingSwitchStart;
+    studio->totalCompleteNs += studio->lastCompleteNs;
+    studio->maxCompleteNs = std::max(studio->maxCompleteNs, studio->lastCompleteNs);
+    studio->completed++;
+    studio->pendingSwitchStart = 0;
+}
+
+SceneSwitchStats Studio::getSceneSwitchStats() {
+    std::unique_lock<std::mutex> lock(switch_stats_mutex);
+    SceneSwitchStats stats = {};
+    stats.switches = switches;
+    stats.lastDispatchNs = lastDispatchNs;
+    stats.avgDispatchNs = switches ? totalDispatchNs / switches : 0;
+    stats.maxDispatchNs = maxDispatchNs;
+    stats.completed = completed;
+    stats.lastCompleteNs = lastCompleteNs;
+    stats.avgCompleteNs = completed ? totalCompleteNs / completed : 0;
+    stats.maxCompleteNs = maxCompleteNs;
+    return stats;
+}
+
+static bool source_ready(obs_source_t *source) {
+    // async sources get their size from the first decoded frame
+    if (obs_source_get_width(source) == 0) {
+        return false;
+    }
+    auto state = obs_source_media_get_state(source);
+    return state != OBS_MEDIA_STATE_OPENING && state != OBS_MEDIA_STATE_BUFFERING && state != OBS_MEDIA_STATE_ERROR;
+}
+
+void Studio::prepareScene(std::string &sceneId, int timeoutMs,
+                          std::function<void(std::vector<std::string> &)> callback) {
+    std::vector<std::pair<std::string, obs_source_t *>> pending;
+    std::vector<std::string> restarting;
+    {
+        // sources may be added, removed or restarted by the command queue meanwhile
+        std::unique_lock<std::mutex> lock(scenes_mtx);
+        Scene *scene = findScene(sceneId);
+        if (scene != currentScene) {
+            scene->prepare();
+            // hold our own references, a source restarted meanwhile just reports not ready
+            for (auto &source : scene->getSources()) {
+                if (busySources.count(source.second)) {
+                    restarting.push_back(source.first);
+                    continue;
+                }
+                obs_source_t *obs_source = source.second->getObsSource();
+                if (obs_source) {
+                    pending.emplace_back(source.first, obs_source_get_ref(obs_source));
+                }
+            }
+        }
+    }
+
+    auto prepare = std::make_shared<ScenePrepare>();
+    prepare->sceneId = sceneId;
+    prepare->cancelled = false;
+    prepare->done = false;
+
+    std::unique_lock<std::mutex> lock(prepares_mutex);
+    // join the polls that are over, a prepare per switch adds up otherwise
+    for (auto it = prepares.begin(); it != prepares.end();) {
+        if ((*it)->done) {
+            (*it)->thread.join();
+            it = prepares.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    prepare->thread = std::thread([this, prepare, pending, restarting, timeoutMs, callback]() mutable {
+        uint64_t deadline = os_gettime_ns() + (uint64_t) std::max(timeoutMs, 0) * 1000000;
+        while (true) {
+            pending.erase(std::remove_if(pending.begin(), pending.end(), [](auto &source) {
+                if (!source_ready(source.second)) {
+                    return false;
+                }
+                obs_source_release(source.second);
+                return true;
+            }), pending.end());
+            if (pending.empty() || os_gettime_ns() >= deadline) {
+                break;
+            }
+            std::unique_lock<std::mutex> lock(prepares_mutex);
+            if (prepares_cv.wait_for(lock, std::chrono::milliseconds(10), [&prepare] { return prepare->cancelled; })) {
+                break;
+            }
+        }
+
+        std::vector<std::string> notReady = restarting;
+        for (auto &source : pending) {
+            notReady.push_back(source.first);
+            obs_source_release(source.second);
+        }
+        callback(notReady);
+
+        std::unique_lock<std::mutex> lock(prepares_mutex);
+        prepare->done = true;
+    });
+    prepares.push_back(prepare);
+}
+
+void Studio::cancelPrepares(const std::string *sceneId) {
+    std::vector<std::shared_ptr<ScenePrepare>> cancelled;
+    {
+        std::unique_lock<std::mutex> lock(prepares_mutex);
+        for (auto it = prepares.begin(); it != prepares.end();) {
+            if (!sceneId || (*it)->sceneId == *sceneId) {
+                (*it)->cancelled = true;
+                cancelled.push_back(*it);
+                it = prepares.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    prepares_cv.notify_all();
+    for (auto &prepare : cancelled) {
+        prepare->thread.join();
+    }
+}
+
+void Studio::unprepareScene(std::string &sceneId) {
+    cancelPrepares(&sceneId);
+    std::unique_lock<std::mutex> lock(scenes_mtx);
+    Scene *scene = findScene(sceneId);
+    // the scene on air keeps showing through the transition
+    if (scene != currentScene) {
+        scene->unprepare();
+    }
 }
 
 void Studio::loadModule(const std::string &binPath, const std::string &dataPath) {
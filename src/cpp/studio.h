@@ -5,9 +5,29 @@
 #include "display.h"
 #include "output.h"
 #include "overlay.h"
+#include "dsk.h"
+#include <condition_variable>
+#include <functional>
+#include <list>
 #include <map>
+#include <mutex>
+#include <set>
+#include <thread>
 #include <obs.h>
 
+struct SceneSwitchStats {
+    uint64_t switches;
+    // switchToScene until the transition is started, the main thread time of a switch
+    uint64_t lastDispatchNs;
+    uint64_t avgDispatchNs;
+    uint64_t maxDispatchNs;
+    // switchToScene until the transition_stop signal, includes the transition duration
+    uint64_t completed;
+    uint64_t lastCompleteNs;
+    uint64_t avgCompleteNs;
+    uint64_t maxCompleteNs;
+};
+
 class Studio {
 
 public:
@@ -25,14 +45,59 @@ public:
 
     void addScene(std::string &sceneId);
 
+    // The scene on air can't be removed, switch away from it first.
+    void removeScene(std::string &sceneId);
+
+    // The source is started outside the scene lock and only published to the scene once it's started.
     void addSource(std::string &sceneId, std::string &sourceId, std::shared_ptr<SourceSettings> &settings);
 
-    Source *findSource(std::string &sceneId, std::string &sourceId);
+    // A source that is restarting is freed once its restart is done.
+    void removeSource(std::string &sceneId, std::string &sourceId);
+
+    void restartSource(std::string &sceneId, std::string &sourceId);
+
+    // Restarts the source on the new url.
+    void setSourceUrl(std::string &sceneId, std::string &sourceId, const std::string &url);
+
+    // Runs fn with the scene lock held, the source can't be stopped or removed by another thread meanwhile.
+    // Keep fn short, throws for a source that is restarting.
+    void withSource(std::string &sceneId, std::string &sourceId, const std::function<void(Source *)> &fn);
 
     void addDSK(std::string &id, std::string &position, std::string &url, int left, int top, int width, int height);
 
+    void updateDSK(std::string &id, std::string &position, std::string &url, int left, int top, int width, int height);
+
+    void removeDSK(std::string &id);
+
+    // Takes ownership of the settings, the output starts right away.
+    void addOutput(OutputSettings *outputSettings);
+
+    void removeOutput(const std::string &outputId);
+
+    Output *findOutput(const std::string &outputId);
+
+    // Applies the settings updateOutput couldn't change live, the output reconnects.
+    void restartOutput(const std::string &outputId);
+
+    std::map<std::string, Output *> &getOutputs();
+
+    // Program outputs followed by the outputs of every transcoded source.
+    std::vector<OutputStats> getOutputStats();
+
     void switchToScene(std::string &sceneId, std::string &transitionType, int transitionMs);
 
+    SceneSwitchStats getSceneSwitchStats();
+
+    // Media sources decode whether they are on air or not, this waits until every source of the scene has
+    // a decoded frame and isn't buffering so that the next switch to it doesn't show a black or stale
+    // picture. The scene is kept showing off-air meanwhile. The callback runs on a worker thread once
+    // every source is ready or the timeout elapsed, with the ids of the sources that still weren't ready.
+    // unprepareScene and shutdown cancel the wait, the callback still runs then.
+    void prepareScene(std::string &sceneId, int timeoutMs, std::function<void(std::vector<std::string> &)> callback);
+
+    // Drops the off-air showing of a prepared scene that isn't switched to after all.
+    void unprepareScene(std::string &sceneId);
+
     void createDisplay(std::string &displayName, void *parentHandle, int scaleFactor, std::string &sourceId);
 
     void destroyDisplay(std::string &displayName);
@@ -61,7 +126,22 @@ public:
 
 private:
     static void loadModule(const std::string &binPath, const std::string &dataPath);
+    static void transition_stop_callback(void *param, calldata_t *data);
     Scene *findScene(std::string &sceneId);
+    Dsk *findDSK(std::string &id);
+
+    struct ScenePrepare {
+        std::string sceneId;
+        std::thread thread;
+        bool cancelled;
+        bool done;
+    };
+
+    // Cancels and joins the readiness polls of the scene, of every scene for nullptr.
+    void cancelPrepares(const std::string *sceneId);
+
+    // Runs fn on the source with the scene lock dropped, the source is marked busy meanwhile.
+    void runBusy(std::string &sceneId, std::string &sourceId, const std::function<void(Source *)> &fn);
 
     static std::string obsPath;
     Settings *settings;
@@ -69,7 +149,27 @@ private:
     std::map<std::string, obs_source_t *> transitions;
     std::map<std::string, Display *> displays;
     std::map<std::string, Dsk *> dsks;
+    obs_scene_t *dsk_scene;
     std::map<std::string, Overlay *> overlays;
     Scene *currentScene;
-    std::vector<Output *> outputs;
+    // guarded by the scene lock: "<sceneId>/<sourceId>" of the sources addSource is starting,
+    // the sources restarting and the busy sources removed meanwhile, freed by runBusy
+    std::set<std::string> startingSources;
+    std::set<Source *> busySources;
+    std::set<Source *> orphanedSources;
+    // the readiness polls of prepareScene, joined before the sources they reference go away
+    std::mutex prepares_mutex;
+    std::condition_variable prepares_cv;
+    std::list<std::shared_ptr<ScenePrepare>> prepares;
+    std::mutex switch_stats_mutex;
+    uint64_t pendingSwitchStart;
+    uint64_t switches;
+    uint64_t lastDispatchNs;
+    uint64_t totalDispatchNs;
+    uint64_t maxDispatchNs;
+    uint64_t completed;
+    uint64_t lastCompleteNs;
+    uint64_t totalCompleteNs;
+    uint64_t maxCompleteNs;
+    std::map<std::string, Output *> outputs;
 };
\ No newline at end of file
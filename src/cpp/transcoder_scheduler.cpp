@@ -0,0 +1,177 @@
+#include "transcoder_scheduler.h"
+#include "source_transcoder.h"
+#include <algorithm>
+#include <util/platform.h>
+#include <util/util_uint64.h>
+
+#define SCHEDULER_MAX_TASKS 1024
+
+TranscoderScheduler &TranscoderScheduler::getInstance() {
+    static TranscoderScheduler scheduler;
+    return scheduler;
+}
+
+TranscoderScheduler::TranscoderScheduler() :
+        mutex(),
+        clocks(),
+        pool(nullptr),
+        ticks(0),
+        lateTicks(0),
+        skippedTicks(0),
+        jitterNs(0),
+        maxJitterNs(0) {
+}
+
+void TranscoderScheduler::add(SourceTranscoder *transcoder, uint32_t fpsNum, uint32_t fpsDen) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (!pool) {
+        size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        pool = new WorkerPool(threads, SCHEDULER_MAX_TASKS);
+        blog(LOG_INFO, "Transcoder scheduler started with %d workers", (int) threads);
+    }
+
+    auto entry = new Entry();
+    entry->transcoder = transcoder;
+    entry->busy = false;
+    entry->missed = 0;
+
+    // transcoders with the same frame rate share one clock
+    uint64_t interval = util_mul_div64(1000000000UL, fpsDen, fpsNum);
+    auto it = clocks.find(interval);
+    if (it != clocks.end()) {
+        it->second->entries.push_back(entry);
+        return;
+    }
+
+    auto clock = new Clock();
+    clock->interval = interval;
+    clock->entries.push_back(entry);
+    clock->stop = false;
+    clock->thread = std::thread(&TranscoderScheduler::runClock, this, clock);
+    clocks[interval] = clock;
+}
+
+void TranscoderScheduler::remove(SourceTranscoder *transcoder) {
+    Entry *entry = nullptr;
+    Clock *stopped = nullptr;
+    WorkerPool *stoppedPool = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (auto it = clocks.begin(); it != clocks.end() && !entry; ++it) {
+            auto &entries = it->second->entries;
+            for (auto e = entries.begin(); e != entries.end(); ++e) {
+                if ((*e)->transcoder == transcoder) {
+                    entry = *e;
+                    entries.erase(e);
+                    break;
+                }
+            }
+            if (entry && entries.empty()) {
+                stopped = it->second;
+                stopped->stop = true;
+                clocks.erase(it);
+                break;
+            }
+        }
+        if (clocks.empty()) {
+            stoppedPool = pool;
+            pool = nullptr;
+        }
+    }
+
+    if (stopped) {
+        stopped->thread.join();
+        delete stopped;
+    }
+
+    // wait for the tick in flight
+    if (entry) {
+        while (entry->busy) {
+            os_sleep_ms(1);
+        }
+        delete entry;
+    }
+
+    if (stoppedPool) {
+        delete stoppedPool;
+        blog(LOG_INFO, "Transcoder scheduler stopped");
+    }
+}
+
+SchedulerStats TranscoderScheduler::getStats() {
+    std::unique_lock<std::mutex> lock(mutex);
+    SchedulerStats stats = {};
+    stats.clockThreads = clocks.size();
+    stats.workerThreads = pool ? pool->getThreadCount() : 0;
+    for (auto &clock : clocks) {
+        stats.transcoders += clock.second->entries.size();
+    }
+    stats.ticks = ticks;
+    stats.lateTicks = lateTicks;
+    stats.skippedTicks = skippedTicks;
+    stats.avgJitterNs = ticks ? jitterNs / ticks : 0;
+    stats.maxJitterNs = maxJitterNs;
+    return stats;
+}
+
+WorkerPool *TranscoderScheduler::getWorkerPool() {
+    std::unique_lock<std::mutex> lock(mutex);
+    return pool;
+}
+
+void TranscoderScheduler::runClock(Clock *clock) {
+    uint64_t last_time = os_gettime_ns();
+
+    while (true) {
+        uint64_t target_time = last_time + clock->interval;
+        uint64_t video_time = target_time;
+        uint32_t count = 1;
+        if (!os_sleepto_ns(video_time)) {
+            count = (uint32_t) ((os_gettime_ns() - last_time) / clock->interval);
+            video_time = last_time + clock->interval * count;
+            lateTicks++;
+        }
+
+        uint64_t jitter = os_gettime_ns() - target_time;
+        jitterNs += jitter;
+        if (jitter > maxJitterNs) {
+            maxJitterNs = jitter;
+        }
+        ticks++;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (clock->stop) {
+                return;
+            }
+            for (auto entry : clock->entries) {
+                dispatch(entry, video_time, count);
+            }
+        }
+        last_time = video_time;
+    }
+}
+
+void TranscoderScheduler::dispatch(Entry *entry, uint64_t videoTime, uint32_t count) {
+    // the previous tick is still running, fold this one into the next
+    if (entry->busy) {
+        entry->missed += count;
+        skippedTicks++;
+        return;
+    }
+
+    uint32_t total = count + entry->missed;
+    entry->busy = true;
+    bool posted = pool->post([entry, videoTime, total] {
+        entry->transcoder->tick(videoTime, total);
+        entry->busy = false;
+    });
+    if (posted) {
+        entry->missed = 0;
+    } else {
+        entry->busy = false;
+        entry->missed = total;
+        skippedTicks++;
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "worker_pool.h"
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class SourceTranscoder;
+
+struct SchedulerStats {
+    size_t clockThreads;
+    size_t workerThreads;
+    size_t transcoders;
+    uint64_t ticks;
+    uint64_t lateTicks;
+    uint64_t skippedTicks;
+    uint64_t avgJitterNs;
+    uint64_t maxJitterNs;
+};
+
+// Paces all source transcoders with one clock thread per frame rate, the
+// per-frame work of every transcoder runs on a shared worker pool.
+class TranscoderScheduler {
+
+public:
+    static TranscoderScheduler &getInstance();
+
+    void add(SourceTranscoder *transcoder, uint32_t fpsNum, uint32_t fpsDen);
+
+    void remove(SourceTranscoder *transcoder);
+
+    SchedulerStats getStats();
+
+    // Pool running the transcoder ticks, null while no transcoder is scheduled.
+    WorkerPool *getWorkerPool();
+
+private:
+    struct Entry {
+        SourceTranscoder *transcoder;
+        std::atomic<bool> busy;
+        uint32_t missed;
+    };
+
+    struct Clock {
+        uint64_t interval;
+        std::vector<Entry *> entries;
+        std::thread thread;
+        bool stop;
+    };
+
+    TranscoderScheduler();
+
+    void runClock(Clock *clock);
+
+    void dispatch(Entry *entry, uint64_t videoTime, uint32_t count);
+
+    std::mutex mutex;
+    std::map<uint64_t, Clock *> clocks;
+    WorkerPool *pool;
+    std::atomic<uint64_t> ticks;
+    std::atomic<uint64_t> lateTicks;
+    std::atomic<uint64_t> skippedTicks;
+    std::atomic<uint64_t> jitterNs;
+    std::atomic<uint64_t> maxJitterNs;
+};
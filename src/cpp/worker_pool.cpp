@@ -0,0 +1,91 @@
+#include "worker_pool.h"
+#include <atomic>
+#include <memory>
+
+struct ParallelJob {
+    std::atomic<size_t> next;
+    std::atomic<size_t> done;
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+WorkerPool::WorkerPool(size_t threadCount, size_t maxTasks) :
+        mutex(),
+        cv(),
+        tasks(),
+        threads(),
+        maxTasks(maxTasks),
+        stopping(false) {
+    for (size_t i = 0; i < threadCount; i++) {
+        threads.emplace_back(&WorkerPool::run, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+bool WorkerPool::post(std::function<void()> task) {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (stopping || tasks.size() >= maxTasks) {
+            return false;
+        }
+        tasks.push_back(std::move(task));
+    }
+    cv.notify_one();
+    return true;
+}
+
+void WorkerPool::parallelFor(size_t count, const std::function<void(size_t)> &fn) {
+    auto job = std::make_shared<ParallelJob>();
+    job->next = 0;
+    job->done = 0;
+
+    // helpers that start after everything is claimed return without touching fn
+    auto work = [job, count, &fn] {
+        size_t i;
+        while ((i = job->next++) < count) {
+            fn(i);
+            if (++job->done == count) {
+                std::unique_lock<std::mutex> lock(job->mutex);
+                job->cv.notify_all();
+            }
+        }
+    };
+
+    for (size_t i = 1; i < count; i++) {
+        post(work);
+    }
+    work();
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->cv.wait(lock, [&job, count] { return job->done == count; });
+}
+
+size_t WorkerPool::getThreadCount() {
+    return threads.size();
+}
+
+void WorkerPool::run() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed size thread pool with a bounded task queue.
+class WorkerPool {
+
+public:
+    WorkerPool(size_t threadCount, size_t maxTasks);
+    ~WorkerPool();
+
+    // Returns false if the queue is full, the task is not run in that case.
+    bool post(std::function<void()> task);
+
+    // Runs fn(0) ... fn(count - 1) across the pool and waits for all of them.
+    // The calling thread takes part, so this is safe to call from a worker.
+    void parallelFor(size_t count, const std::function<void(size_t)> &fn);
+
+    size_t getThreadCount();
+
+private:
+    void run();
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> tasks;
+    std::vector<std::thread> threads;
+    size_t maxTasks;
+    bool stopping;
+};
@@ -26,6 +26,10 @@ declare namespace obs {
 
     export type SourceType = 'Image' | 'MediaSource';
 
+    export type VideoFormat = 'NV12' | 'I420' | 'BGRA';
+
+    export type ScaleType = 'point' | 'fastBilinear' | 'bilinear' | 'bicubic';
+
     export type Position = 'top' | 'top-right' | 'right' | 'bottom-right' | 'bottom' | 'bottom-left' | 'left' | 'top-left' | 'center';
 
     export type TransitionType = 'cut_transition' | 'fade_transition' | 'swipe_transition' | 'slide_transition';
@@ -46,6 +50,91 @@ declare namespace obs {
         audioMonitor: boolean;
     }
 
+    export interface SourceVideoStats {
+        width: number;
+        height: number;
+        format: string;
+        scaleType: ScaleType;
+        renditions: number;
+        frames: number;
+        passthroughFrames: number;
+        slicedFrames: number;
+        avgConvertNs: number;
+    }
+
+    export interface SourceRelayStats {
+        packets: number;
+        bytes: number;
+        reconnects: number;
+        // The input didn't match the output, it's transcoded instead of relayed.
+        transcoded: boolean;
+    }
+
+    export interface SourceStats {
+        framePoolHits: number;
+        framePoolMisses: number;
+        framePoolSize: number;
+        frameLockContention: number;
+        avgCaptureNs: number;
+        avgSelectNs: number;
+        repeatedFrames: number;
+        scalersCreated: number;
+        scalersEvicted: number;
+        audioOverflows: number;
+        audioUnderruns: number;
+        driftPpm: number;
+        driftCorrections: number;
+        videos: SourceVideoStats[];
+        relays: SourceRelayStats[];
+    }
+
+    export interface SchedulerStats {
+        clockThreads: number;
+        workerThreads: number;
+        transcoders: number;
+        ticks: number;
+        lateTicks: number;
+        skippedTicks: number;
+        avgJitterNs: number;
+        maxJitterNs: number;
+    }
+
+    export interface SceneSwitchStats {
+        switches: number;
+        // switchToScene until the transition is started, the time the call blocks.
+        lastDispatchNs: number;
+        avgDispatchNs: number;
+        maxDispatchNs: number;
+        // switchToScene until the transition finished, includes the transition duration.
+        completed: number;
+        lastCompleteNs: number;
+        avgCompleteNs: number;
+        maxCompleteNs: number;
+    }
+
+    export interface PrepareSceneResult {
+        // Every source has a decoded frame and isn't buffering. Media sources decode off-air anyway,
+        // prepareScene only waits for them, it doesn't start decoding.
+        ready: boolean;
+        // Sources that weren't ready when the timeout elapsed.
+        pendingSources: string[];
+    }
+
+    export interface CommandStats {
+        // Commands run by the control thread.
+        commands: number;
+        pending: number;
+        lastRunNs: number;
+        avgRunNs: number;
+        maxRunNs: number;
+        // Time commands waited in the queue behind earlier ones.
+        avgWaitNs: number;
+        // Main thread time spent in startup, addSource and restartSource.
+        syncCalls: number;
+        avgSyncBlockedNs: number;
+        maxSyncBlockedNs: number;
+    }
+
     export interface UpdateSourceSettings {
         url?: string;
         volume?: number;
@@ -74,23 +163,98 @@ declare namespace obs {
         startOnActive: boolean;
         enableBuffer?: boolean;
         bufferSize?: number;
-        output?: OutputSettings;
+        scaleSliceThreshold?: number;
+        output?: OutputSettings | OutputSettings[];
     }
 
     export interface OutputSettings {
+        // Defaults to "output<index>" for the outputs passed to startup and to
+        // "<sceneId>/<sourceId>/output<index>" for source outputs, ids must be unique.
+        id?: string;
         server: string;
         key: string;
-        hardwareEnable: boolean;
-        width: number;
-        height: number;
-        keyintSec: number;
-        rateControl: RateControl;
-        preset: string;
-        profile: string;
-        tune: string;
+        // Skips video entirely, the video encoder settings may be omitted then.
+        audioOnly?: boolean;
+        // Relays the source's H.264/AAC packets without re-encoding, falls back to
+        // transcoding when the codecs, size or bitrate don't match the output. The relay
+        // opens the url a second time, next to the decoding source, and paces and loops files in real time.
+        passthrough?: boolean;
+        // The video encoder settings below are required unless audioOnly is set.
+        hardwareEnable?: boolean;
+        width?: number;
+        height?: number;
+        keyintSec?: number;
+        rateControl?: RateControl;
+        preset?: string;
+        profile?: string;
+        tune?: string;
         x264opts?: string;
-        videoBitrateKbps: number;
+        videoFormat?: VideoFormat;
+        scaleType?: ScaleType;
+        videoBitrateKbps?: number;
         audioBitrateKbps: number;
+        // Steps the video bitrate down on congestion or drops and back up once stable, rtmp only.
+        adaptiveBitrate?: AdaptiveBitrateSettings;
+        reconnect?: ReconnectSettings;
+    }
+
+    export interface ReconnectSettings {
+        // Delay before the first retry, doubled on every further attempt. Defaults to 2.
+        retryDelaySec?: number;
+        // Defaults to 20, 0 disables reconnecting.
+        maxRetries?: number;
+    }
+
+    export interface AdaptiveBitrateSettings {
+        // Defaults to a quarter of videoBitrateKbps.
+        minKbps?: number;
+        // Defaults to videoBitrateKbps, a videoBitrateKbps set by updateOutput replaces it.
+        maxKbps?: number;
+        // Defaults to a tenth of videoBitrateKbps.
+        stepKbps?: number;
+    }
+
+    export interface OutputInfo {
+        id: string;
+        server: string;
+        audioOnly: boolean;
+        active: boolean;
+        videoBitrateKbps: number;
+        bitrateChanges: number;
+        // updateOutput stored fields that wait for restartOutput.
+        restartPending: boolean;
+    }
+
+    export type UpdateOutputSettings = Partial<Pick<OutputSettings, 'server' | 'key' | 'width' | 'height' |
+        'keyintSec' | 'rateControl' | 'preset' | 'profile' | 'tune' | 'x264opts' | 'videoBitrateKbps' |
+        'audioBitrateKbps'>>;
+
+    export interface UpdateOutputResult {
+        // Fields applied to the running encoder.
+        applied: string[];
+        // Fields kept apart from the running output until restartOutput.
+        restartRequired: string[];
+    }
+
+    export interface OutputStats {
+        id: string;
+        // Set for the outputs of a source, absent for program outputs.
+        sceneId?: string;
+        sourceId?: string;
+        active: boolean;
+        totalBytes: number;
+        // Averaged over windows of at least 2 seconds, however often it's polled.
+        bitrateKbps: number;
+        totalFrames: number;
+        // Dropped by the network.
+        droppedFrames: number;
+        // Skipped because the encoder lagged behind.
+        skippedFrames: number;
+        congestion: number;
+        connectTimeMs: number;
+        // Video frame timestamp to encoded packet, moving average, measured while connected. 0 for audio only
+        // and relayed outputs.
+        avgEncoderLatencyNs: number;
     }
 
     export interface Settings {
@@ -107,6 +271,15 @@ declare namespace obs {
         peak: number[],
         input_peak: number[]) => void;
 
+    export type OutputEvent = 'connect' | 'disconnect' | 'reconnect' | 'reconnectSuccess' | 'stop';
+
+    // code is the libobs OBS_OUTPUT_* code, attempt is set for reconnect events.
+    export type OutputEventCallback = (
+        outputId: string,
+        event: OutputEvent,
+        code: number,
+        attempt: number) => void;
+
     export interface Audio {
         masterVolume: number;
         audioWithVideo: boolean;
@@ -153,18 +326,46 @@ declare namespace obs {
     export interface ObsNode {
         setObsPath(obsPath: string): void
         startup(settings: Settings): void;
+        // The *Async variants run one at a time on a control thread in call order, shutdown waits
+        // for the queued ones. Mixing them with the synchronous calls on the same source is safe,
+        // the one that runs second sees the first one's result, e.g. a source not found yet.
+        startupAsync(settings: Settings): Promise<void>;
         shutdown(): void;
         addScene(sceneId: string): string;
+        // Throws for the scene on air.
+        removeScene(sceneId: string): void;
+        // The source is opened before it's added to the scene, the other calls don't wait for it.
         addSource(sceneId: string, sourceId: string, settings: SourceSettings): void;
+        addSourceAsync(sceneId: string, sourceId: string, settings: SourceSettings): Promise<void>;
+        removeSource(sceneId: string, sourceId: string): void;
         getSource(sceneId: string, sourceId: string): Source;
+        getSourceStats(sceneId: string, sourceId: string): SourceStats | undefined;
+        getSchedulerStats(): SchedulerStats;
         updateSource(sceneId: string, sourceId: string, request: UpdateSourceSettings): void;
+        // A restarting source isn't locked meanwhile, the calls that read or change it throw until it's done.
         restartSource(sceneId: string, sourceId: string): void;
+        restartSourceAsync(sceneId: string, sourceId: string): Promise<void>;
+        getCommandStats(): CommandStats;
         switchToScene(sceneId: string, transitionType: TransitionType, transitionMs: number): void;
+        prepareScene(sceneId: string, timeoutMs?: number): Promise<PrepareSceneResult>;
+        // Releases a prepared scene that won't be switched to, switching to it releases it too.
+        unprepareScene(sceneId: string): void;
+        getSceneSwitchStats(): SceneSwitchStats;
         createDisplay(name: string, parentWindow: Buffer, scaleFactor: number, sourceId: string): void;
         destroyDisplay(name: string): void;
         moveDisplay(name: string, x: number, y: number, width: number, height: number): void;
         addDSK(id: string, position: Position, url: string, left: number, top: number, width: number, height: number): void;
+        updateDSK(id: string, position: Position, url: string, left: number, top: number, width: number, height: number): void;
+        removeDSK(id: string): void;
+        addOutput(id: string, settings: OutputSettings): void;
+        removeOutput(id: string): void;
+        updateOutput(id: string, request: UpdateOutputSettings): UpdateOutputResult;
+        // Applies the restartRequired fields of updateOutput, the output reconnects.
+        restartOutput(id: string): void;
+        listOutputs(): OutputInfo[];
+        getOutputStats(): OutputStats[];
         addVolmeterCallback(callback: VolmeterCallback): void;
+        addOutputEventCallback(callback: OutputEventCallback): void;
         getAudio(): Audio;
         updateAudio(request: UpdateAudioRequest): void;
         screenshot(sceneId: string, sourceId: string): Promise<Buffer>;
@@ -0,0 +1,114 @@
+import * as obs from '../src';
+import {execSync} from 'child_process';
+
+// Throttles the link to the rtmp server with tc and checks that the adaptive bitrate
+// steps the output down below the link rate, stays under an explicit ceiling set by
+// updateOutput and climbs back once the link is free. tc needs root, run it as
+//   sudo RTMP_SERVER=rtmp://<server>/live NET_IFACE=<iface> npm run test:adaptive
+const server = process.env.RTMP_SERVER || 'rtmp://127.0.0.1/live';
+const iface = process.env.NET_IFACE || 'lo';
+const sourceUrl = process.env.SOURCE_URL || 'test.mp4';
+const outputId = 'adaptive';
+const maxKbps = 4000;
+const ceilingKbps = 2500;
+const throttleKbps = 1500;
+
+const settings: obs.Settings = {
+    video: {
+        baseWidth: 1280,
+        baseHeight: 720,
+        outputWidth: 1280,
+        outputHeight: 720,
+        fpsNum: 25,
+        fpsDen: 1,
+    },
+    audio: {
+        sampleRate: 44100,
+    },
+    outputs: [
+        {
+            id: outputId,
+            server: server,
+            key: 'adaptive',
+            hardwareEnable: false,
+            width: 1280,
+            height: 720,
+            keyintSec: 1,
+            rateControl: 'CBR',
+            preset: 'veryfast',
+            profile: 'main',
+            tune: 'zerolatency',
+            videoBitrateKbps: maxKbps,
+            audioBitrateKbps: 64,
+            adaptiveBitrate: {
+                minKbps: 500,
+                stepKbps: 250,
+            },
+        },
+    ],
+};
+
+const sleep = (ms: number) => new Promise(resolve => setTimeout(resolve, ms));
+
+const bitrate = () => obs.listOutputs().find(o => o.id === outputId)!.videoBitrateKbps;
+
+const throttle = (kbps: number) =>
+    execSync(`tc qdisc replace dev ${iface} root tbf rate ${kbps}kbit burst 32kbit latency 400ms`);
+
+const unthrottle = () => execSync(`tc qdisc del dev ${iface} root || true`);
+
+// polls until the check passes, returns false on timeout
+const waitFor = async (description: string, timeoutSec: number, check: (kbps: number) => boolean) => {
+    for (let i = 0; i < timeoutSec; i++) {
+        const kbps = bitrate();
+        const stats = obs.getOutputStats().find(s => s.id === outputId)!;
+        console.log(`${description}: ${kbps}kbps, sent ${stats.bitrateKbps}kbps, congestion ${stats.congestion.toFixed(2)}`);
+        if (check(kbps)) {
+            return true;
+        }
+        await sleep(1000);
+    }
+    console.error(`${description}: timed out`);
+    return false;
+};
+
+const run = async () => {
+    obs.startup(settings);
+    obs.addScene('scene1');
+    obs.addSource('scene1', 'source1', {
+        type: 'MediaSource',
+        isFile: true,
+        url: sourceUrl,
+        hardwareDecoder: false,
+        startOnActive: false,
+    });
+    obs.switchToScene('scene1', 'cut_transition', 0);
+
+    let passed = await waitFor('unthrottled', 30, kbps => kbps === maxKbps);
+
+    throttle(throttleKbps);
+    passed = passed && await waitFor('throttled', 60, kbps => kbps < throttleKbps);
+
+    unthrottle();
+    passed = passed && await waitFor('recovering', 120, kbps => kbps > throttleKbps);
+
+    // an explicit bitrate becomes the ceiling, stepping up must stop there
+    obs.updateOutput(outputId, {videoBitrateKbps: ceilingKbps});
+    await sleep(30000);
+    passed = passed && bitrate() === ceilingKbps;
+    console.log(`ceiling: ${bitrate()}kbps`);
+
+    console.log(passed ? 'PASSED' : 'FAILED');
+    return passed;
+};
+
+run()
+    .catch(e => {
+        console.error(e);
+        return false;
+    })
+    .then(passed => {
+        unthrottle();
+        obs.shutdown();
+        process.exit(passed ? 0 : 1);
+    });
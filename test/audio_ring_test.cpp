@@ -0,0 +1,152 @@
+#include "audio_ring.h"
+#include <media-io/audio-io.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#define TEST_SAMPLE_RATE 48000
+
+// Sample values wrap before floats lose integer precision.
+static float sample_value(uint64_t index, size_t channel) {
+    float value = (float) (index % 1048576);
+    return channel ? -value : value;
+}
+
+static uint32_t next_packet_frames(uint32_t &seed) {
+    seed = seed * 1664525u + 1013904223u;
+    return 1 + (seed >> 8) % (3 * AUDIO_OUTPUT_FRAMES);
+}
+
+// One producer and one consumer hammer the ring, every sample and timestamp has to come out
+// in order. Run under ThreadSanitizer to check the index publication.
+TEST(AudioRingTest, KeepsOrderUnderContention) {
+    const uint64_t totalFrames = 20000000;
+    AudioRing ring;
+    ring.open(2, TEST_SAMPLE_RATE);
+
+    std::thread producer([&] {
+        std::vector<float> left(3 * AUDIO_OUTPUT_FRAMES);
+        std::vector<float> right(3 * AUDIO_OUTPUT_FRAMES);
+        uint32_t seed = 1;
+        uint64_t produced = 0;
+        while (produced < totalFrames) {
+            uint32_t frames = (uint32_t) std::min<uint64_t>(next_packet_frames(seed), totalFrames - produced);
+            for (uint32_t i = 0; i < frames; i++) {
+                left[i] = sample_value(produced + i, 0);
+                right[i] = sample_value(produced + i, 1);
+            }
+            uint8_t *data[2] = {(uint8_t *) left.data(), (uint8_t *) right.data()};
+            while (!ring.push(audio_frames_to_ns(TEST_SAMPLE_RATE, produced), data, frames)) {
+                std::this_thread::yield();
+            }
+            produced += frames;
+        }
+    });
+
+    uint64_t consumed = 0;
+    uint64_t mismatches = 0;
+    while (consumed < totalFrames) {
+        AudioRingPacket *packet = ring.front();
+        if (!packet) {
+            std::this_thread::yield();
+            continue;
+        }
+        // split packets add the slot offset to the packet timestamp, which may round 1 ns apart
+        uint64_t expected = audio_frames_to_ns(TEST_SAMPLE_RATE, consumed);
+        if (packet->timestamp + 1 < expected || packet->timestamp > expected + 1) {
+            mismatches++;
+        }
+        for (uint32_t i = 0; i < packet->frames; i++) {
+            if (packet->data[0][i] != sample_value(consumed + i, 0) ||
+                packet->data[1][i] != sample_value(consumed + i, 1)) {
+                mismatches++;
+            }
+        }
+        consumed += packet->frames;
+        ring.pop();
+    }
+    producer.join();
+
+    EXPECT_EQ(consumed, totalFrames);
+    EXPECT_EQ(mismatches, 0u);
+    EXPECT_EQ(ring.front(), nullptr);
+}
+
+// 64 sources deliver 10 ms packets in real time with bursts, one output thread takes
+// AUDIO_OUTPUT_FRAMES from every source per tick like audio_output_callback does. After
+// the initial buffering no tick may find a source short of audio.
+TEST(AudioRingTest, NoUnderrunsWith64Sources) {
+    using clock = std::chrono::steady_clock;
+    const int sources = 64;
+    const int packetFrames = TEST_SAMPLE_RATE / 100;
+    const auto duration = std::chrono::seconds(3);
+    const int bufferTicks = 3;
+
+    std::vector<std::unique_ptr<AudioRing>> rings;
+    for (int i = 0; i < sources; i++) {
+        rings.push_back(std::make_unique<AudioRing>());
+        rings.back()->open(1, TEST_SAMPLE_RATE);
+    }
+
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> overflows(0);
+    auto start = clock::now();
+    std::vector<std::thread> producers;
+    for (int s = 0; s < sources; s++) {
+        producers.emplace_back([&, s] {
+            std::vector<float> samples(packetFrames * 2, 0.5f);
+            uint8_t *data[1] = {(uint8_t *) samples.data()};
+            uint64_t packet = 0;
+            while (!stop) {
+                // every 8th packet arrives late together with the next one
+                uint32_t frames = packetFrames;
+                if (packet % 8 == 7) {
+                    packet++;
+                    frames *= 2;
+                }
+                packet++;
+                std::this_thread::sleep_until(start + std::chrono::milliseconds(10 * packet));
+                if (!rings[s]->push(audio_frames_to_ns(TEST_SAMPLE_RATE, packet * packetFrames), data, frames)) {
+                    overflows++;
+                }
+            }
+        });
+    }
+
+    // output thread, buffered frames per source after draining its ring
+    std::vector<uint64_t> buffered(sources, 0);
+    uint64_t underruns = 0;
+    uint64_t ticks = 0;
+    auto tickInterval = std::chrono::nanoseconds(audio_frames_to_ns(TEST_SAMPLE_RATE, AUDIO_OUTPUT_FRAMES));
+    while (clock::now() - start < duration) {
+        ticks++;
+        std::this_thread::sleep_until(start + tickInterval * ticks);
+        for (int s = 0; s < sources; s++) {
+            while (AudioRingPacket *packet = rings[s]->front()) {
+                buffered[s] += packet->frames;
+                rings[s]->pop();
+            }
+            if (ticks <= bufferTicks) {
+                continue;
+            }
+            if (buffered[s] < AUDIO_OUTPUT_FRAMES) {
+                underruns++;
+                buffered[s] = 0;
+            } else {
+                buffered[s] -= AUDIO_OUTPUT_FRAMES;
+            }
+        }
+    }
+    stop = true;
+    for (auto &producer : producers) {
+        producer.join();
+    }
+
+    EXPECT_GT(ticks, (uint64_t) bufferTicks);
+    EXPECT_EQ(underruns, 0u);
+    EXPECT_EQ(overflows, 0u);
+}
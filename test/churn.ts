@@ -0,0 +1,73 @@
+import * as obs from '../src';
+
+// Adds and removes sources over and over and checks that the process memory settles,
+// a leak per source shows up as RSS growing with the number of iterations.
+//   SOURCE_URL=<file or url> npm run test:churn
+const sourceUrl = process.env.SOURCE_URL || 'test.mp4';
+const iterations = Number(process.env.CHURN_ITERATIONS || 1000);
+const warmup = 100;
+const maxGrowthMb = Number(process.env.CHURN_MAX_GROWTH_MB || 50);
+
+const settings: obs.Settings = {
+    video: {
+        baseWidth: 1280,
+        baseHeight: 720,
+        outputWidth: 1280,
+        outputHeight: 720,
+        fpsNum: 25,
+        fpsDen: 1,
+    },
+    audio: {
+        sampleRate: 44100,
+    },
+};
+
+const sourceSettings: obs.SourceSettings = {
+    type: 'MediaSource',
+    isFile: true,
+    url: sourceUrl,
+    hardwareDecoder: false,
+    startOnActive: false,
+};
+
+const rssMb = () => process.memoryUsage().rss / 1024 / 1024;
+
+const sleep = (ms: number) => new Promise(resolve => setTimeout(resolve, ms));
+
+const run = async () => {
+    obs.startup(settings);
+    obs.addScene('churn');
+    obs.switchToScene('churn', 'cut_transition', 0);
+
+    let baseline = 0;
+    for (let i = 0; i < iterations; i++) {
+        obs.addSource('churn', `source${i}`, sourceSettings);
+        // let the source open and decode a little before it goes away
+        await sleep(10);
+        obs.removeSource('churn', `source${i}`);
+
+        if (i + 1 === warmup) {
+            baseline = rssMb();
+        }
+        if ((i + 1) % 100 === 0) {
+            console.log(`${i + 1} sources: rss ${rssMb().toFixed(1)}MB`);
+        }
+    }
+
+    // let the decoder threads of the last sources wind down before the last sample
+    await sleep(1000);
+    const growth = rssMb() - baseline;
+    console.log(`rss growth after warmup: ${growth.toFixed(1)}MB, limit ${maxGrowthMb}MB`);
+    return growth <= maxGrowthMb;
+};
+
+run()
+    .catch(e => {
+        console.error(e);
+        return false;
+    })
+    .then(passed => {
+        console.log(passed ? 'PASSED' : 'FAILED');
+        obs.shutdown();
+        process.exit(passed ? 0 : 1);
+    });
@@ -0,0 +1,72 @@
+import * as obs from '../src';
+
+// Switches scenes while a source on an unreachable url is still being added, the switches
+// must not wait for the source to open.
+//   SOURCE_URL=<slow or unreachable url> npm run test:pending
+const sourceUrl = process.env.SOURCE_URL || 'rtmp://10.255.255.1/live/unreachable';
+const maxSwitchMs = Number(process.env.MAX_SWITCH_MS || 100);
+
+const settings: obs.Settings = {
+    video: {
+        baseWidth: 1280,
+        baseHeight: 720,
+        outputWidth: 1280,
+        outputHeight: 720,
+        fpsNum: 25,
+        fpsDen: 1,
+    },
+    audio: {
+        sampleRate: 44100,
+    },
+};
+
+const sleep = (ms: number) => new Promise(resolve => setTimeout(resolve, ms));
+
+const run = async () => {
+    obs.startup(settings);
+    obs.addScene('scene1');
+    obs.addScene('scene2');
+    obs.switchToScene('scene1', 'cut_transition', 0);
+
+    let pending = true;
+    const added = obs.addSourceAsync('scene2', 'unreachable', {
+        type: 'MediaSource',
+        isFile: false,
+        url: sourceUrl,
+        hardwareDecoder: false,
+        startOnActive: false,
+    }).catch(e => console.log(`addSource failed: ${e.message}`)).then(() => pending = false);
+
+    let switches = 0;
+    let maxMs = 0;
+    for (let i = 0; pending && i < 1000; i++) {
+        const start = process.hrtime.bigint();
+        obs.switchToScene(i % 2 ? 'scene1' : 'scene2', 'cut_transition', 0);
+        const ms = Number(process.hrtime.bigint() - start) / 1e6;
+        // a switch that returned after the source settled didn't overlap it
+        if (pending) {
+            switches++;
+            maxMs = Math.max(maxMs, ms);
+        }
+        await sleep(10);
+    }
+    await added;
+
+    console.log(`${switches} switches while pending, max ${maxMs.toFixed(1)}ms, limit ${maxSwitchMs}ms`);
+    if (switches === 0) {
+        console.error('the source was added before the first switch, use a slower url');
+        return false;
+    }
+    return maxMs <= maxSwitchMs;
+};
+
+run()
+    .catch(e => {
+        console.error(e);
+        return false;
+    })
+    .then(passed => {
+        console.log(passed ? 'PASSED' : 'FAILED');
+        obs.shutdown();
+        process.exit(passed ? 0 : 1);
+    });
@@ -0,0 +1,64 @@
+#include "scale_slices.h"
+#include <gtest/gtest.h>
+
+struct ScaleCase {
+    uint32_t in_height;
+    uint32_t out_height;
+};
+
+class ScaleSlicesTest : public ::testing::TestWithParam<ScaleCase> {
+};
+
+// The kept rows have to tile the output and every band has to run at the full frame's ratio
+// on the same filter and dither phase, otherwise the bands don't add up to the unsliced scale.
+TEST_P(ScaleSlicesTest, BandsTileTheOutputAtTheFullFrameRatio) {
+    auto c = GetParam();
+    auto slices = plan_scale_slices(c.in_height, c.out_height, 4);
+    ASSERT_GE(slices.size(), 2u);
+    ASSERT_LE(slices.size(), 4u);
+
+    uint32_t next = 0;
+    for (auto &slice : slices) {
+        EXPECT_EQ(slice.out_row, next);
+        EXPECT_EQ(slice.out_row % 16, 0u);
+        EXPECT_EQ(slice.in_row % 2, 0u);
+        EXPECT_LE(slice.skip + slice.keep, slice.out_rows);
+        EXPECT_EQ((uint64_t) slice.in_rows * c.out_height, (uint64_t) slice.out_rows * c.in_height);
+        EXPECT_EQ((uint64_t) slice.in_row * c.out_height, (uint64_t) (slice.out_row - slice.skip) * c.in_height);
+        EXPECT_EQ((slice.out_row - slice.skip) % 16, 0u);
+        // margins are only cut short at the frame edges
+        if (slice.out_row > 0) {
+            EXPECT_GE(slice.skip, 16u);
+        }
+        if (slice.out_row + slice.keep < c.out_height) {
+            EXPECT_GE(slice.out_rows - slice.skip - slice.keep, 16u);
+        }
+        EXPECT_LE(slice.in_row + slice.in_rows, c.in_height);
+        next = slice.out_row + slice.keep;
+    }
+    EXPECT_EQ(next, c.out_height);
+    EXPECT_EQ(slices.front().in_row, 0u);
+    EXPECT_EQ(slices.back().in_row + slices.back().in_rows, c.in_height);
+}
+
+INSTANTIATE_TEST_SUITE_P(ExactRatios, ScaleSlicesTest, ::testing::Values(
+        ScaleCase{2160, 1080},
+        ScaleCase{2160, 720},
+        ScaleCase{2160, 1440},
+        ScaleCase{1440, 720},
+        ScaleCase{1080, 720},
+        ScaleCase{1080, 540},
+        ScaleCase{720, 1440}
+));
+
+TEST(ScaleSlicesPlanTest, InexactRatiosAreNotSliced) {
+    // 4:3 has no exact swscale step, odd heights break the chroma rows
+    EXPECT_TRUE(plan_scale_slices(1440, 1080, 4).empty());
+    EXPECT_TRUE(plan_scale_slices(2160, 800, 4).empty());
+    EXPECT_TRUE(plan_scale_slices(2161, 1080, 4).empty());
+}
+
+TEST(ScaleSlicesPlanTest, SmallOutputsAreNotSliced) {
+    EXPECT_TRUE(plan_scale_slices(2160, 16, 4).empty());
+    EXPECT_TRUE(plan_scale_slices(2160, 1080, 1).empty());
+}